@@ -0,0 +1,195 @@
+/**
+ * zob rss parser benchmark: parses feed fixtures the way a fetch does, in
+ * 16 KiB chunks (curl's largest write callback), with the run-at-a-time
+ * sweep of parse_rss() and with the byte-at-a-time loop it replaced, and
+ * prints one JSON object per fixture:
+ *
+ *   {"fixture":"bench/fixtures/fullcontent.xml","bytes":153022,"items":20,
+ *    "bytewise_mb_per_s":154.6,"swept_mb_per_s":963.6,"speedup":6.23}
+ *
+ * - *_mb_per_s: best of several whole-document parses, in MB (10^6 bytes)
+ *   of feed per second.
+ * - items: items handed to the callback; both loops must agree on every
+ *   item, or the benchmark fails.
+ *
+ * Usage: bench_rss fixture.xml...
+ */
+/* The parser is built into this file so the old loop can share its helpers */
+#include "utils/rss_parser.c"
+
+#include <stdlib.h>
+#include <time.h>
+
+#define CHUNK_SIZE 16384
+
+/**
+ * parse_rss() as it was before the sweep: one switch per byte, and field
+ * text appended a byte at a time.
+ */
+static bool parseBytewise(struct RssParser *parser, const char *chunk, size_t len) {
+     for (size_t i = 0; i < len && parser->count < MAX_ARTICLES; ++i) {
+          char c = chunk[i];
+
+          switch (parser->state) {
+               case STATE_TEXT:
+                    if (c == '<') {
+                         parser->state = STATE_TAG;
+                         parser->tagLen = 0;
+                         parser->tag[0] = '\0';
+                         parser->nameDone = false;
+                         parser->selfClosing = false;
+                    } else {
+                         appendField(parser, &c, 1);
+                    }
+                    break;
+
+               case STATE_TAG:
+                    if (c == '>') {
+                         parser->state = STATE_TEXT;
+                         handleTag(parser);
+                         break;
+                    }
+                    parser->selfClosing = c == '/';
+                    if (parser->nameDone) break;
+                    if (isspace((unsigned char)c) || (c == '/' && parser->tagLen > 0)) {
+                         parser->nameDone = true;
+                         break;
+                    }
+                    if (parser->tagLen < sizeof(parser->tag) - 1) {
+                         parser->tag[parser->tagLen++] = c;
+                         parser->tag[parser->tagLen] = '\0';
+                    }
+                    if (strcmp(parser->tag, "![CDATA[") == 0) {
+                         parser->state = STATE_CDATA;
+                         parser->match = 0;
+                    } else if (strcmp(parser->tag, "!--") == 0) {
+                         parser->state = STATE_COMMENT;
+                         parser->match = 0;
+                    }
+                    break;
+
+               case STATE_CDATA:
+                    if (c == ']' && parser->match < 2) {
+                         parser->match++;
+                    } else if (c == '>' && parser->match == 2) {
+                         parser->state = STATE_TEXT;
+                    } else if (c == ']') {
+                         appendField(parser, "]", 1);
+                    } else {
+                         appendField(parser, "]]", parser->match);
+                         parser->match = 0;
+                         appendField(parser, &c, 1);
+                    }
+                    break;
+
+               case STATE_COMMENT:
+                    if (c == '-') {
+                         if (parser->match < 2) parser->match++;
+                    } else {
+                         if (c == '>' && parser->match == 2) parser->state = STATE_TEXT;
+                         parser->match = 0;
+                    }
+                    break;
+          }
+     }
+
+     return parser->count < MAX_ARTICLES;
+}
+
+typedef bool (*ParseFn)(struct RssParser *parser, const char *chunk, size_t len);
+
+/* Everything the callback saw, folded into one hash so the two loops can be compared */
+typedef struct {
+     int items;
+     uint64_t digest;
+} Digest;
+
+static void digestItem(const struct RssItem *item, void *userdata) {
+     Digest *digest = userdata;
+     digest->items++;
+     digest->digest = hash64(item, sizeof(*item), digest->digest);
+}
+
+static Digest parse(ParseFn parseFn, const char *feed, size_t length) {
+     Digest digest = {0, 0};
+     struct RssParser parser;
+
+     rssParserInit(&parser, digestItem, &digest);
+     for (size_t offset = 0; offset < length; offset += CHUNK_SIZE) {
+          size_t chunk = length - offset < CHUNK_SIZE ? length - offset : CHUNK_SIZE;
+          if (!parseFn(&parser, feed + offset, chunk)) break;
+     }
+     return digest;
+}
+
+static double now(void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Best of at least 5 passes and a quarter of a second, in MB/s */
+static double throughput(ParseFn parseFn, const char *feed, size_t length) {
+     double best = 1e30, started = now();
+     for (int pass = 0; pass < 5 || now() - started < 0.25; ++pass) {
+          double start = now();
+          parse(parseFn, feed, length);
+          double elapsed = now() - start;
+          if (elapsed < best) best = elapsed;
+     }
+     return length / best / 1e6;
+}
+
+static char *readFixture(const char *path, size_t *length) {
+     FILE *file = fopen(path, "rb");
+     if (!file) {
+          perror(path);
+          return NULL;
+     }
+     char *data = NULL;
+     if (fseek(file, 0, SEEK_END) == 0) {
+          long size = ftell(file);
+          rewind(file);
+          data = size >= 0 ? malloc(size + 1) : NULL;
+          if (data && fread(data, 1, size, file) != (size_t)size) {
+               free(data);
+               data = NULL;
+          }
+          *length = size;
+     }
+     if (!data) fprintf(stderr, "bench_rss: could not read %s\n", path);
+     fclose(file);
+     return data;
+}
+
+int main(int argc, char **argv) {
+     if (argc < 2) {
+          fprintf(stderr, "usage: %s fixture.xml...\n", argv[0]);
+          return 1;
+     }
+
+     int status = 0;
+     for (int i = 1; i < argc; ++i) {
+          size_t length;
+          char *feed = readFixture(argv[i], &length);
+          if (!feed) {
+               status = 1;
+               continue;
+          }
+
+          Digest swept = parse(parse_rss, feed, length);
+          Digest bytewise = parse(parseBytewise, feed, length);
+          if (swept.items != bytewise.items || swept.digest != bytewise.digest) {
+               fprintf(stderr, "bench_rss: %s: the two loops disagree\n", argv[i]);
+               status = 1;
+          }
+
+          double before = throughput(parseBytewise, feed, length);
+          double after = throughput(parse_rss, feed, length);
+          printf("{\"fixture\":\"%s\",\"bytes\":%zu,\"items\":%d,\"bytewise_mb_per_s\":%.1f,"
+                 "\"swept_mb_per_s\":%.1f,\"speedup\":%.2f}\n",
+                 argv[i], length, swept.items, before, after, after / before);
+          free(feed);
+     }
+     return status;
+}
@@ -0,0 +1,659 @@
+/**
+ * zob tex benchmark: runs tokenizeMarkdown() and convertTokensToLatex() on
+ * synthetic corpora and prints one JSON object per corpus and size, so runs
+ * can be diffed or fed to a script:
+ *
+ *   {"corpus":"prose","bytes":1048576,"tokens":20311,"mb_per_s":412.7,
+ *    "peak_rss_kb":9840,"allocs":14,"alloc_bytes":3407872}
+ *
+ * - mb_per_s: best of several tokenize + convert passes, in MB (10^6 bytes)
+ *   of markdown per second.
+ * - peak_rss_kb: high-water mark of a forked child that builds the corpus
+ *   and converts it once, so it includes the corpus itself.
+ * - allocs, alloc_bytes: malloc/calloc/realloc calls and bytes requested in
+ *   one pass, counted by wrapping them at link time (-Wl,--wrap).
+ *
+ * Before those, it prints the memory ceiling of one large mixed document,
+ * converted the three ways zob tex can: streamed to a file through the
+ * TEX_OUT_BUFFER_SIZE writer (-j 1), split across threads (-j 4), and built
+ * as a single string:
+ *
+ *   {"memory":"stream","bytes":104857600,"input_kb":102400,
+ *    "peak_rss_kb":104508,"allocs":1,"alloc_bytes":1048576}
+ *
+ * - peak_rss_kb includes the input, input_kb of it, as the mapped file
+ *   does in zob tex.
+ *
+ * Usage: bench_tex [size-in-KiB...] (default: 64 1024 16384, and 100 MiB
+ * for the memory ceiling, which otherwise uses the largest size given)
+ *        bench_tex --scan [size-in-KiB] (default: 256), see runScans()
+ *        bench_tex --escapes [size-in-KiB [unescaped-build]] (default: 256),
+ *          see runEscapes()
+ *        bench_tex --check [documents] (default: 500), see runCheck()
+ */
+/* The converter is built into this file, so the scanners it keeps static can be timed */
+#include "zob_tex.c"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Allocator interposition: the linker routes every call here first */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static size_t allocCount;
+static size_t allocBytes;
+
+void *__wrap_malloc(size_t size) {
+     allocCount++;
+     allocBytes += size;
+     return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+     allocCount++;
+     allocBytes += count * size;
+     return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+     allocCount++;
+     allocBytes += size;
+     return __real_realloc(ptr, size);
+}
+
+/* Deterministic generator, so every run benchmarks the same bytes */
+static unsigned long long seed;
+
+static unsigned next(unsigned bound) {
+     seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+     return (unsigned)(seed >> 33) % bound;
+}
+
+static const char *const WORDS[] = {
+    "the",   "zen",  "of",   "plain", "text",   "binder", "notes",   "about",
+    "every", "day",  "thing", "worth", "a",     "line",   "written", "down",
+    "slowly", "and", "with", "care",  "before", "sleep",  "again",   "now",
+};
+#define WORD_COUNT (sizeof(WORDS) / sizeof(WORDS[0]))
+
+typedef struct {
+     char *data;
+     size_t length;
+     size_t capacity;
+} Corpus;
+
+static void append(Corpus *corpus, const char *text) {
+     size_t length = strlen(text);
+     if (corpus->length + length > corpus->capacity) length = corpus->capacity - corpus->length;
+     memcpy(corpus->data + corpus->length, text, length);
+     corpus->length += length;
+}
+
+static void appendWords(Corpus *corpus, unsigned count) {
+     for (unsigned i = 0; i < count; ++i) {
+          if (i > 0) append(corpus, " ");
+          append(corpus, WORDS[next(WORD_COUNT)]);
+     }
+}
+
+/* Paragraphs of sentences under an occasional header */
+static void proseBlock(Corpus *corpus) {
+     if (next(8) == 0) {
+          append(corpus, "## ");
+          appendWords(corpus, 3);
+          append(corpus, "\n\n");
+     }
+     for (unsigned sentences = 3 + next(4); sentences > 0; --sentences) {
+          appendWords(corpus, 6 + next(12));
+          append(corpus, ". ");
+     }
+     append(corpus, "\n\n");
+}
+
+static void listBlock(Corpus *corpus) {
+     for (unsigned items = 4 + next(8); items > 0; --items) {
+          append(corpus, "- ");
+          appendWords(corpus, 2 + next(6));
+          append(corpus, "\n");
+     }
+     append(corpus, "\n");
+}
+
+static void linkBlock(Corpus *corpus) {
+     char link[96];
+     for (unsigned links = 3 + next(4); links > 0; --links) {
+          appendWords(corpus, 1 + next(4));
+          snprintf(link, sizeof(link), " [%s %s](https://example.com/%u) ", WORDS[next(WORD_COUNT)],
+                   WORDS[next(WORD_COUNT)], next(100000));
+          append(corpus, link);
+     }
+     append(corpus, "\n\n");
+}
+
+static void codeBlock(Corpus *corpus) {
+     appendWords(corpus, 8);
+     append(corpus, "\n```\n");
+     for (unsigned lines = 4 + next(12); lines > 0; --lines) {
+          append(corpus, "    int ");
+          append(corpus, WORDS[next(WORD_COUNT)]);
+          append(corpus, " = compute(x, y) * 2; /* ");
+          appendWords(corpus, 3);
+          append(corpus, " */\n");
+     }
+     append(corpus, "```\n\n");
+}
+
+/* All of the above, in about the proportions of a real document */
+static void mixedBlock(Corpus *corpus) {
+     unsigned pick = next(8);
+     if (pick < 5) {
+          proseBlock(corpus);
+     } else if (pick == 5) {
+          listBlock(corpus);
+     } else if (pick == 6) {
+          linkBlock(corpus);
+     } else {
+          codeBlock(corpus);
+     }
+}
+
+typedef struct {
+     const char *name;
+     void (*block)(Corpus *corpus);
+} CorpusKind;
+
+static const CorpusKind KINDS[] = {
+    {"prose", proseBlock},
+    {"list", listBlock},
+    {"link", linkBlock},
+    {"code", codeBlock},
+    {"mixed", mixedBlock},
+};
+#define MIXED (&KINDS[4])
+
+static Corpus generate(const CorpusKind *kind, size_t size) {
+     Corpus corpus = {malloc(size), 0, size};
+     if (!corpus.data) {
+          perror("malloc");
+          exit(1);
+     }
+     seed = 42;
+     while (corpus.length < corpus.capacity) kind->block(&corpus);
+     return corpus;
+}
+
+/* One tokenize + convert pass; returns the token count */
+static size_t convert(const Corpus *corpus) {
+     TokenList list;
+     tokenListInit(&list);
+     if (!tokenizeMarkdown(corpus->data, corpus->length, &list)) {
+          fprintf(stderr, "bench_tex: tokenizing failed\n");
+          exit(1);
+     }
+     char *latex = convertTokensToLatex(&list);
+     if (!latex) {
+          fprintf(stderr, "bench_tex: conversion failed\n");
+          exit(1);
+     }
+     size_t tokens = list.count;
+     free(latex);
+     tokenListFree(&list);
+     return tokens;
+}
+
+static double now(void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Peak RSS in KiB of a child that builds the corpus and converts it once */
+static long peakRss(const CorpusKind *kind, size_t size) {
+     struct rusage usage;
+     int status;
+
+     fflush(stdout);
+     pid_t pid = fork();
+     if (pid < 0) return -1;
+     if (pid == 0) {
+          Corpus corpus = generate(kind, size);
+          convert(&corpus);
+          _exit(0);
+     }
+     if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+          return -1;
+     return usage.ru_maxrss;
+}
+
+/* Best of at least 3 passes and half a second, in MB/s */
+static double throughput(const Corpus *corpus) {
+     double best = 1e30, started = now();
+     for (int pass = 0; pass < 3 || now() - started < 0.5; ++pass) {
+          double start = now();
+          convert(corpus);
+          double elapsed = now() - start;
+          if (elapsed < best) best = elapsed;
+     }
+     return corpus->length / best / 1e6;
+}
+
+static void run(const CorpusKind *kind, size_t size) {
+     Corpus corpus = generate(kind, size);
+
+     allocCount = allocBytes = 0;
+     size_t tokens = convert(&corpus);
+     size_t allocs = allocCount, bytes = allocBytes;
+     double mbPerS = throughput(&corpus);
+
+     printf("{\"corpus\":\"%s\",\"bytes\":%zu,\"tokens\":%zu,\"mb_per_s\":%.1f,"
+            "\"peak_rss_kb\":%ld,\"allocs\":%zu,\"alloc_bytes\":%zu}\n",
+            kind->name, corpus.length, tokens, mbPerS, peakRss(kind, size), allocs, bytes);
+     free(corpus.data);
+}
+
+#if defined(TEX_NO_ESCAPES)
+#define ESCAPES "off"
+#else
+#define ESCAPES "on"
+#endif
+
+/* The corpora the escaping overhead is judged on: text that needs none, as most text does */
+static const CorpusKind *const ESCAPE_KINDS[] = {&KINDS[0], &KINDS[2]};
+#define ESCAPE_KIND_COUNT (sizeof(ESCAPE_KINDS) / sizeof(ESCAPE_KINDS[0]))
+
+/* Prints this build's throughput on each of the ESCAPE_KINDS, keeping the best in `mbPerS` */
+static void timeEscapes(size_t size, double mbPerS[ESCAPE_KIND_COUNT]) {
+     for (size_t k = 0; k < ESCAPE_KIND_COUNT; ++k) {
+          Corpus corpus = generate(ESCAPE_KINDS[k], size);
+          double current = throughput(&corpus);
+          if (current > mbPerS[k]) mbPerS[k] = current;
+          printf("{\"escapes\":\"" ESCAPES "\",\"corpus\":\"%s\",\"bytes\":%zu,"
+                 "\"mb_per_s\":%.1f}\n",
+                 ESCAPE_KINDS[k]->name, corpus.length, current);
+          free(corpus.data);
+     }
+}
+
+/* Runs the `unescaped` build once, keeping the best of its timings in `mbPerS` */
+static bool timeUnescaped(const char *unescaped, size_t size, double mbPerS[ESCAPE_KIND_COUNT]) {
+     char command[PATH_MAX + 32], line[256], name[16];
+     double current;
+     size_t found = 0;
+
+     snprintf(command, sizeof(command), "%s --escapes %zu", unescaped, size / 1024);
+     fflush(stdout);
+     FILE *child = popen(command, "r");
+     if (!child) return false;
+     while (fgets(line, sizeof(line), child)) {
+          if (sscanf(line, "{\"escapes\":\"off\",\"corpus\":\"%15[^\"]\",\"bytes\":%*u,"
+                           "\"mb_per_s\":%lf}", name, &current) != 2)
+               continue;
+          for (size_t k = 0; k < ESCAPE_KIND_COUNT; ++k) {
+               if (strcmp(name, ESCAPE_KINDS[k]->name) != 0) continue;
+               if (current > mbPerS[k]) mbPerS[k] = current;
+               found++;
+          }
+     }
+     return pclose(child) == 0 && found == ESCAPE_KIND_COUNT;
+}
+
+/**
+ * What escaping costs a whole tokenize + convert pass, on text that needs
+ * none. Each build times the prose and link corpora with its own converter:
+ *
+ *   {"escapes":"on","corpus":"prose","bytes":262144,"mb_per_s":3983.2}
+ *
+ * Given the -DTEX_NO_ESCAPES build, which passes text through as it is,
+ * the default build takes turns with it, so both see the same machine, and
+ * prints the cost of escaping from the best of each:
+ *
+ *   {"escapes":"cost","corpus":"prose","escaped_mb_per_s":3983.2,
+ *    "unescaped_mb_per_s":4070.6,"overhead":0.022}
+ */
+static int runEscapes(size_t size, const char *unescaped) {
+     double escaped[ESCAPE_KIND_COUNT] = {0}, bypassed[ESCAPE_KIND_COUNT] = {0};
+     for (int round = 0; round < (unescaped ? 5 : 1); ++round) {
+          timeEscapes(size, escaped);
+          if (unescaped && !timeUnescaped(unescaped, size, bypassed)) {
+               fprintf(stderr, "bench_tex: no timings from %s\n", unescaped);
+               return 1;
+          }
+     }
+
+     for (size_t k = 0; unescaped && k < ESCAPE_KIND_COUNT; ++k) {
+          printf("{\"escapes\":\"cost\",\"corpus\":\"%s\",\"escaped_mb_per_s\":%.1f,"
+                 "\"unescaped_mb_per_s\":%.1f,\"overhead\":%.3f}\n",
+                 ESCAPE_KINDS[k]->name, escaped[k], bypassed[k], bypassed[k] / escaped[k] - 1);
+     }
+     return 0;
+}
+
+typedef enum { MEMORY_STREAM, MEMORY_PARALLEL, MEMORY_STRING } MemoryMode;
+
+static const char *const MEMORY_MODES[] = {"stream", "parallel", "string"};
+
+/**
+ * Converts a mixed document of `size` bytes once, in `mode`, in a forked
+ * child that reports its own high-water mark, so no mode sees the heap
+ * another one left behind.
+ */
+static void runMemory(MemoryMode mode, size_t size) {
+     int status;
+
+     fflush(stdout);
+     pid_t pid = fork();
+     if (pid < 0) return;
+     if (pid == 0) {
+          Corpus corpus = generate(MIXED, size);
+          struct rusage usage;
+          struct OutBuf out;
+          struct Arena arena;
+          long tokens = 0;
+
+          allocCount = allocBytes = 0;
+          if (mode == MEMORY_STRING) {
+               convert(&corpus);
+          } else if (outBufInit(&out, open("/dev/null", O_WRONLY), TEX_OUT_BUFFER_SIZE)) {
+               arenaInit(&arena);
+               tokens = mode == MEMORY_STREAM
+                            ? convertMarkdownStream(corpus.data, corpus.length, &arena, &out)
+                            : convertMarkdownParallel(corpus.data, corpus.length, 4, &out);
+               outBufFlush(&out);
+               arenaFree(&arena);
+          }
+          if (tokens < 0) _exit(1);
+
+          getrusage(RUSAGE_SELF, &usage);
+          printf("{\"memory\":\"%s\",\"bytes\":%zu,\"input_kb\":%zu,\"peak_rss_kb\":%ld,"
+                 "\"allocs\":%zu,\"alloc_bytes\":%zu}\n",
+                 MEMORY_MODES[mode], corpus.length, corpus.length / 1024, usage.ru_maxrss,
+                 allocCount, allocBytes);
+          fflush(stdout);
+          _exit(0);
+     }
+     if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+          fprintf(stderr, "bench_tex: %s conversion failed\n", MEMORY_MODES[mode]);
+}
+
+#if defined(TEX_AVX2)
+#define SCAN_ISA "avx2"
+#elif defined(TEX_SSE2)
+#define SCAN_ISA "sse2"
+#else
+#define SCAN_ISA "scalar"
+#endif
+
+/* Timestamp counter where there is one, nanoseconds elsewhere */
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_UNIT "cycle"
+static unsigned long long ticks(void) { return __rdtsc(); }
+#else
+#define SCAN_UNIT "ns"
+static unsigned long long ticks(void) { return (unsigned long long)(now() * 1e9); }
+#endif
+
+/* Where each sweep ended, so the compiler can't drop the scans */
+static volatile uintptr_t scanSink;
+
+/* Sweeps with one scanner from start to end, stepping past each byte it stops at */
+static void sweepText(const char *ptr, const char *end) {
+     bool special = false;
+     while ((ptr = scanText(ptr, end, &special)) < end) ptr++;
+     scanSink = (uintptr_t)ptr + special;
+}
+
+static void sweepEscapes(const char *ptr, const char *end) {
+     while ((ptr = scanEscapes(ptr, end)) < end) ptr++;
+     scanSink = (uintptr_t)ptr;
+}
+
+static void sweepLines(const char *ptr, const char *end) {
+     bool special = false;
+     while ((ptr = scanUntil(ptr, end, '\n', &special)) < end) ptr++;
+     scanSink = (uintptr_t)ptr + special;
+}
+
+/**
+ * scanText() as it was before it looked for LaTeX specials: TEXT_STOP bytes
+ * only. Timed beside it, this is what finding escapes in the same pass costs.
+ */
+static const char *scanStops(const char *ptr, const char *end) {
+#if defined(TEX_AVX2)
+     for (; end - ptr >= 32; ptr += 32) {
+          __m256i chunk = _mm256_loadu_si256((const __m256i *)ptr);
+          __m256i hits = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+          hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('*')));
+          hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('[')));
+          hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('`')));
+          hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('#')));
+          hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('-')));
+          unsigned mask = (unsigned)_mm256_movemask_epi8(hits);
+          if (mask) return ptr + __builtin_ctz(mask);
+     }
+#elif defined(TEX_SSE2)
+     for (; end - ptr >= 16; ptr += 16) {
+          __m128i chunk = _mm_loadu_si128((const __m128i *)ptr);
+          __m128i hits = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+          hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('*')));
+          hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('[')));
+          hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('`')));
+          hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('#')));
+          hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('-')));
+          unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+          if (mask) return ptr + __builtin_ctz(mask);
+     }
+#endif
+     while (ptr < end && !TEXT_STOP[(unsigned char)*ptr]) ptr++;
+     return ptr;
+}
+
+static void sweepStops(const char *ptr, const char *end) {
+     while ((ptr = scanStops(ptr, end)) < end) ptr++;
+     scanSink = (uintptr_t)ptr;
+}
+
+typedef struct {
+     const char *name;
+     void (*sweep)(const char *ptr, const char *end);
+} Scanner;
+
+static const Scanner SCANNERS[] = {
+    {"stops", sweepStops},
+    {"text", sweepText},
+    {"escapes", sweepEscapes},
+    {"lines", sweepLines},
+};
+
+/**
+ * Bytes per cycle of each tokenizer scan over each corpus, best of many
+ * sweeps of a cache-sized buffer, so memory bandwidth stays out of it. The
+ * vector width is fixed at build time; make bench-tex runs this for the
+ * table-only (-DTEX_NO_SIMD), default and -mavx2 builds:
+ *
+ *   {"scan":"text","isa":"sse2","corpus":"prose","bytes_per_cycle":1.45}
+ */
+static void runScans(size_t size) {
+#if defined(TEX_AVX2)
+     if (!__builtin_cpu_supports("avx2")) {
+          fprintf(stderr, "bench_tex: this CPU has no AVX2, skipping the avx2 scans\n");
+          return;
+     }
+#endif
+     for (size_t k = 0; k < sizeof(KINDS) / sizeof(KINDS[0]); ++k) {
+          Corpus corpus = generate(&KINDS[k], size);
+          const char *end = corpus.data + corpus.length;
+
+          for (size_t i = 0; i < sizeof(SCANNERS) / sizeof(SCANNERS[0]); ++i) {
+               unsigned long long best = ~0ULL;
+               for (int pass = 0; pass < 50; ++pass) {
+                    unsigned long long start = ticks();
+                    SCANNERS[i].sweep(corpus.data, end);
+                    unsigned long long elapsed = ticks() - start;
+                    if (elapsed < best) best = elapsed;
+               }
+               printf("{\"scan\":\"%s\",\"isa\":\"%s\",\"corpus\":\"%s\","
+                      "\"bytes_per_" SCAN_UNIT "\":%.2f}\n",
+                      SCANNERS[i].name, SCAN_ISA, KINDS[k].name,
+                      (double)corpus.length / (best ? best : 1));
+          }
+          free(corpus.data);
+     }
+}
+
+/**
+ * Markdown built to trip up the parallel split: blank lines everywhere,
+ * including inside fences, lists, bold, italic and links, fences that are
+ * left open or that only the pre-scan takes for fences, and LaTeX specials.
+ */
+static const char *const FRAGMENTS[] = {
+    "\n\n", "\n\n", "\n\n", "\n", "\n", "**",   "*",    "[",     "](",     ")",
+    "]",     "```",  "\n```\n", "`",  "- ",   "-",    "\n- ", "\n# ",  "\n## ",  "# ",
+    "&",     "%",    "$",      "_",  "{",    "}",    "~",    "^",     "\\",    "#",
+};
+#define FRAGMENT_COUNT (sizeof(FRAGMENTS) / sizeof(FRAGMENTS[0]))
+
+static void fuzzBlock(Corpus *corpus) {
+     for (unsigned pieces = 1 + next(16); pieces > 0; --pieces) {
+          if (next(2)) {
+               appendWords(corpus, 1 + next(6));
+          } else {
+               append(corpus, FRAGMENTS[next(FRAGMENT_COUNT)]);
+          }
+     }
+}
+
+/* Converts the whole corpus into a string, streamed or split `jobs` ways */
+static char *convertAll(const Corpus *corpus, size_t jobs, size_t *length, long *tokens) {
+     struct OutBuf out;
+     struct Arena arena;
+
+     if (!outBufInit(&out, -1, corpus->length + 1)) return NULL;
+     arenaInit(&arena);
+     *tokens = jobs > 1 ? convertMarkdownParallel(corpus->data, corpus->length, jobs, &out)
+                        : convertMarkdownStream(corpus->data, corpus->length, &arena, &out);
+     arenaFree(&arena);
+     *length = out.length;
+     return outBufRelease(&out);
+}
+
+/**
+ * Segments of a `jobs`-way split of the corpus that tokenizing in order
+ * finds out of step, and has to redo: the ones whose boundary fell inside a
+ * fence, a span or a link. Replays convertMarkdownParallel()'s check.
+ */
+static size_t resyncedSegments(const Corpus *corpus, size_t jobs, size_t *count) {
+     TexSegment *segments = calloc(jobs * 4, sizeof(TexSegment));
+     const char *end = corpus->data + corpus->length, *ptr = corpus->data;
+     bool insideCodeBlock = false;
+     size_t resynced = 0;
+
+     *count = 0;
+     if (!segments) return 0;
+     *count = splitSegments(corpus->data, corpus->length, segments, jobs * 4);
+     for (size_t i = 0; i < *count; ++i) {
+          resynced += segments[i].start != ptr || insideCodeBlock;
+          tokenizeSegment(&segments[i], ptr, insideCodeBlock, end);
+          ptr = segments[i].stop;
+          insideCodeBlock = segments[i].stopInsideCodeBlock;
+          tokenListFree(&segments[i].tokens);
+     }
+     free(segments);
+     return resynced;
+}
+
+/**
+ * Checks that splitting a document across threads changes nothing: each of
+ * `documents` fuzzed inputs of up to 64 KiB is converted serially and then
+ * 2, 3, 8 and 64 ways, and the LaTeX compared byte for byte. Prints
+ *
+ *   {"check":"parallel","documents":500,"segments":45770,"resynced":24417,
+ *    "mismatches":0}
+ *
+ * where resynced counts the segments whose boundary the split got wrong, so
+ * the check is seen to exercise that path.
+ *
+ * @return The number of mismatches.
+ */
+static size_t runCheck(size_t documents) {
+     static const size_t JOBS[] = {2, 3, 8, 64};
+     size_t segments = 0, resynced = 0, mismatches = 0;
+
+     for (size_t doc = 0; doc < documents; ++doc) {
+          size_t size = 1 + (doc * 7919) % (64 << 10);
+          Corpus corpus = {malloc(size), 0, size};
+          if (!corpus.data) {
+               perror("malloc");
+               exit(1);
+          }
+          /* Each document its own, reproducible, stream of fragments */
+          seed = doc;
+          while (corpus.length < corpus.capacity) fuzzBlock(&corpus);
+
+          size_t serialLength;
+          long serialTokens;
+          char *serial = convertAll(&corpus, 1, &serialLength, &serialTokens);
+          for (size_t j = 0; serial && j < sizeof(JOBS) / sizeof(JOBS[0]); ++j) {
+               size_t length, count;
+               long tokens;
+               char *parallel = convertAll(&corpus, JOBS[j], &length, &tokens);
+               if (!parallel || tokens != serialTokens || length != serialLength ||
+                   memcmp(parallel, serial, length) != 0) {
+                    fprintf(stderr, "bench_tex: document %zu differs when split %zu ways\n", doc,
+                            JOBS[j]);
+                    mismatches++;
+               }
+               free(parallel);
+               resynced += resyncedSegments(&corpus, JOBS[j], &count);
+               segments += count;
+          }
+          if (!serial) mismatches++;
+          free(serial);
+          free(corpus.data);
+     }
+
+     printf("{\"check\":\"parallel\",\"documents\":%zu,\"segments\":%zu,\"resynced\":%zu,"
+            "\"mismatches\":%zu}\n",
+            documents, segments, resynced, mismatches);
+     return mismatches;
+}
+
+int main(int argc, char **argv) {
+     size_t defaults[] = {64, 1024, 16384};
+     size_t count = argc > 1 ? (size_t)argc - 1 : sizeof(defaults) / sizeof(defaults[0]);
+     size_t largest = 100 << 10;
+
+     if (argc > 1 && strcmp(argv[1], "--scan") == 0) {
+          runScans(argc > 2 ? strtoul(argv[2], NULL, 10) * 1024 : 256 * 1024);
+          return 0;
+     }
+     if (argc > 1 && strcmp(argv[1], "--escapes") == 0) {
+          size_t kib = argc > 2 ? strtoul(argv[2], NULL, 10) : 256;
+          return runEscapes((kib ? kib : 256) * 1024, argc > 3 ? argv[3] : NULL);
+     }
+     if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+          return runCheck(argc > 2 ? strtoul(argv[2], NULL, 10) : 500) ? 1 : 0;
+     }
+
+     if (argc > 1) largest = 0;
+     for (int i = 1; i < argc; ++i) {
+          size_t kib = strtoul(argv[i], NULL, 10);
+          if (kib > largest) largest = kib;
+     }
+
+     /* First, while this process is small: the children start from a copy of it */
+     for (MemoryMode mode = MEMORY_STREAM; mode <= MEMORY_STRING; ++mode) {
+          if (largest > 0) runMemory(mode, largest * 1024);
+     }
+     for (size_t k = 0; k < sizeof(KINDS) / sizeof(KINDS[0]); ++k) {
+          for (size_t i = 0; i < count; ++i) {
+               size_t kib = argc > 1 ? strtoul(argv[i + 1], NULL, 10) : defaults[i];
+               if (kib > 0) run(&KINDS[k], kib * 1024);
+          }
+     }
+     return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * zob rss search test: archives a few items in a scratch database and
+ * searches it with queries FTS5 takes as they are and with queries it
+ * rejects, which are retried with every term quoted. Then it drops the FTS5
+ * index, as an SQLite without FTS5 never has one, and searches again
+ * through the LIKE fallback. Built with ASan, so an overrun while quoting
+ * fails the run too. Prints one JSON object per query and index:
+ *
+ *   {"index":"fts5","query":"a\"b \"","quoted":"\"a\"\"b\" \"\"\"\"","hits":0,
+ *    "ok":true}
+ *
+ * Usage: test_rss (HOME is pointed at a temporary directory)
+ */
+/* The store is built into this file so its static quoting can be checked */
+#include "utils/rss_store.c"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * A query, what quoteTerms() must make of it, and how many items it must
+ * find with the FTS5 index and, taken as one substring, without it.
+ */
+static const struct {
+     const char *query;
+     const char *quoted;
+     int hits;
+     int likeHits;
+} SEARCHES[] = {
+    {"zig", "\"zig\"", 1, 1},
+    {"\"", "\"\"\"\"", 0, 0},
+    {"a\"b \"", "\"a\"\"b\" \"\"\"\"", 0, 0},
+    {"\"\"\" \" \"", "\"\"\"\"\"\"\"\" \"\"\"\" \"\"\"\"", 0, 0},
+    {"zig (0.14", "\"zig\" \"(0.14\"", 1, 0},
+    {"C++ without", "\"C++\" \"without\"", 1, 1},
+    {"item 1%", "\"item\" \"1%\"", 1, 0},
+};
+
+static void countHit(const struct RssSearchHit *hit, void *userdata) {
+     (void)hit;
+     (*(int *)userdata)++;
+}
+
+/* Prints `text` as the body of a JSON string */
+static void printJson(const char *text) {
+     for (; *text; ++text) {
+          if (*text == '"' || *text == '\\') putchar('\\');
+          putchar(*text);
+     }
+}
+
+static bool archive(sqlite3 *db) {
+     static struct RssFeed feed;
+     const char *titles[] = {"Zig 0.14 released", "Writing C++ without exceptions"};
+     for (size_t i = 0; i < sizeof(titles) / sizeof(titles[0]); ++i) {
+          struct RssItem *item = &feed.items[feed.count++];
+          snprintf(item->title, sizeof(item->title), "%s", titles[i]);
+          snprintf(item->link, sizeof(item->link), "https://example.com/%zu", i);
+          snprintf(item->description, sizeof(item->description), "Item %zu of the test feed", i);
+          item->id = i + 1;
+     }
+     return rssCacheSave(db, "test", "https://example.com/feed", "", "", &feed) == SQLITE_OK;
+}
+
+int main(void) {
+     char home[] = "/tmp/zob-test-rss-XXXXXX", dir[sizeof(home) + 8];
+     if (!mkdtemp(home)) {
+          perror("mkdtemp");
+          return 1;
+     }
+     snprintf(dir, sizeof(dir), "%s%s", home, ZOB_DIRECTORY);
+     setenv("HOME", home, 1);
+
+     sqlite3 *db;
+     if (mkdir(dir, 0700) != 0 || rssStoreOpen(&db) != SQLITE_OK || !archive(db)) {
+          fprintf(stderr, "test_rss: could not set up a database under %s\n", home);
+          return 1;
+     }
+
+     int status = 0;
+     for (int like = 0; like < 2; ++like) {
+          if (like && db_execute(db, "DROP TRIGGER RssArticlesIndex; "
+                                     "DROP TABLE RssArticlesFts;") != SQLITE_OK)
+               return 1;
+          for (size_t i = 0; i < sizeof(SEARCHES) / sizeof(SEARCHES[0]); ++i) {
+               char *quoted = quoteTerms(SEARCHES[i].query);
+               int hits = 0;
+               int found = rssArchiveSearch(db, SEARCHES[i].query, 10, countHit, &hits);
+               bool ok = quoted && strcmp(quoted, SEARCHES[i].quoted) == 0 && hits == found &&
+                         found == (like ? SEARCHES[i].likeHits : SEARCHES[i].hits);
+               printf("{\"index\":\"%s\",\"query\":\"", like ? "like" : "fts5");
+               printJson(SEARCHES[i].query);
+               printf("\",\"quoted\":\"");
+               printJson(quoted ? quoted : "");
+               printf("\",\"hits\":%d,\"ok\":%s}\n", found, ok ? "true" : "false");
+               if (!ok) status = 1;
+               free(quoted);
+          }
+     }
+
+     db_close(db);
+     char path[sizeof(dir) + 16];
+     snprintf(path, sizeof(path), "%s/%s", dir, ZOB_DB_NAME);
+     unlink(path);
+     rmdir(dir);
+     rmdir(home);
+     return status;
+}
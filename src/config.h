@@ -1,6 +1,8 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <stdbool.h>
+
 /**
  * ZOB GLOBAL
  */
@@ -8,12 +10,30 @@
 #define ZOB_DB_NAME "zob.db"
 #define ZOBMASTER "Matthieu Court"
 #define MAX_TODOS 50
+/* Prepared statements kept per database connection, reused by SQL text */
+#define DB_STATEMENT_CACHE_SIZE 32
 
 /**
  * ZOB RSS
+ *
+ * `publications[]` seeds the feed registry in the zob database the first
+ * time it is created; after that, feeds are managed with `zob rss add/remove`.
  */
 #define NUM_PUBLICATIONS 3
 #define MAX_ARTICLES 20
+/* Multiplex feeds that share an origin over one HTTP/2 connection */
+#define RSS_HTTP2_MULTIPLEX 1
+/* Transfers kept in flight at once when fetching many feeds */
+#define RSS_MAX_PARALLEL 32
+/* Bounds (seconds) of the adaptive per-feed polling interval */
+#define RSS_POLL_MIN (15 * 60)
+#define RSS_POLL_MAX (24 * 60 * 60)
+/* Longest the daemon sleeps before re-reading the registry for new feeds */
+#define RSS_DAEMON_MAX_SLEEP (5 * 60)
+/* Shortest it sleeps, even when a feed is still past due after a refresh */
+#define RSS_DAEMON_MIN_SLEEP 60
+/* Results shown by `zob rss search` */
+#define RSS_SEARCH_LIMIT 20
 
 struct Publication {
      int id;
@@ -31,16 +51,44 @@ static const struct Publication publications[NUM_PUBLICATIONS] = {
 /**
  * ZOB FMT
  */
-#define LINTER_CMD_MAX_SIZE 512
+/* Linters zob fmt runs at once; 0 means one per core */
+#define FMT_JOBS 0
+#define LINTER_MAX_ARGS 8
+/* Most files handed to one run of a linter that takes many */
+#define FMT_BATCH_MAX 256
+/* Quiet time after a save before zob fmt --watch lints the file */
+#define FMT_WATCH_DEBOUNCE_MS 100
 
-static const char *LINTER_MAPPING[][2] = {
-    {"c", "clang-format -style=\"{BasedOnStyle: google, IndentWidth: 5, ColumnLimit: 100}\" -i %s"},
+/**
+ * The linter for files ending in .<extension>: its argv, to which the file is
+ * appended, or as many files as fit when `batch` says it takes several.
+ * `lines`, if the linter can format only part of a file, is a printf format
+ * for one argument per range of lines, given the first and last line.
+ */
+struct Linter {
+     const char* extension;
+     const char* argv[LINTER_MAX_ARGS];
+     bool batch;
+     const char* lines;
+};
+
+#define CLANG_FORMAT \
+     {"clang-format", "-style={BasedOnStyle: google, IndentWidth: 5, ColumnLimit: 100}", "-i"}
+
+static const struct Linter LINTER_MAPPING[] = {
+    {"c", CLANG_FORMAT, true, "--lines=%u:%u"},
+    {"h", CLANG_FORMAT, true, "--lines=%u:%u"},
 };
 
 
 /**
  * ZOB TEX
  */
+/* Output is written through a buffer of this size, whatever the document size */
+#define TEX_OUT_BUFFER_SIZE (1 << 20)
+/* Documents this big are split across one thread per core, unless -j says otherwise */
+#define TEX_PARALLEL_MIN_SIZE (8 << 20)
+
 static const char* LATEX_PRELUDE =
     "\\documentclass{article}\n"
     "\\usepackage[utf8]{inputenc}\n"
@@ -0,0 +1,59 @@
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct ArenaBlock {
+     struct ArenaBlock *next;
+     size_t size;
+     size_t used;
+     alignas(max_align_t) char data[];
+};
+
+void arenaInit(struct Arena *arena) { arena->head = NULL; }
+
+/**
+ * Returns `size` bytes aligned for any type, or NULL when out of memory.
+ *
+ * Requests larger than a block get a block of their own.
+ */
+void *arenaAlloc(struct Arena *arena, size_t size) {
+     size_t aligned = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+     struct ArenaBlock *block = arena->head;
+
+     if (!block || block->size - block->used < aligned) {
+          size_t blockSize = aligned > ARENA_BLOCK_SIZE ? aligned : ARENA_BLOCK_SIZE;
+          block = malloc(sizeof(struct ArenaBlock) + blockSize);
+          if (!block) return NULL;
+          block->size = blockSize;
+          block->used = 0;
+          block->next = arena->head;
+          arena->head = block;
+     }
+
+     void *ptr = block->data + block->used;
+     block->used += aligned;
+     return ptr;
+}
+
+/* Empties the arena but keeps its newest block, so reuse doesn't allocate */
+void arenaReset(struct Arena *arena) {
+     if (!arena->head) return;
+
+     struct ArenaBlock *rest = arena->head->next;
+     arena->head->next = NULL;
+     arena->head->used = 0;
+     while (rest) {
+          struct ArenaBlock *next = rest->next;
+          free(rest);
+          rest = next;
+     }
+}
+
+void arenaFree(struct Arena *arena) {
+     arenaReset(arena);
+     free(arena->head);
+     arena->head = NULL;
+}
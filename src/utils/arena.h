@@ -0,0 +1,22 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * Bump allocator: allocations are carved out of large blocks and released
+ * all at once. Blocks are never moved, so pointers stay valid until the
+ * arena is reset or freed.
+ */
+struct ArenaBlock;
+
+struct Arena {
+     struct ArenaBlock *head;
+};
+
+void arenaInit(struct Arena *arena);
+void *arenaAlloc(struct Arena *arena, size_t size);
+void arenaReset(struct Arena *arena);
+void arenaFree(struct Arena *arena);
+
+#endif  // ARENA_H
@@ -1,5 +1,24 @@
 #include "db_utils.h"
+#include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../config.h"
+
+/**
+ * Builds the path to the zob database at the root of the ZOB_DIRECTORY.
+ *
+ * @return A pointer to a static buffer, or NULL if HOME is not set.
+ */
+const char *db_zob_path(void) {
+  static char path[PATH_MAX];
+  const char *homeDir = getenv("HOME");
+  if (!homeDir) return NULL;
+  snprintf(path, sizeof(path), "%s%s/%s", homeDir, ZOB_DIRECTORY, ZOB_DB_NAME);
+  return path;
+}
 
 /**
  * Opens a connection to an SQLite database.
@@ -64,3 +83,308 @@ int db_query(sqlite3 *db, const char *sql,
   }
   return rc;
 }
+
+/* A prepared statement kept for reuse, found again by its SQL text */
+struct CachedStatement {
+  sqlite3 *db;
+  const char *sql;
+  sqlite3_stmt *stmt;
+  unsigned long lastUse;
+};
+
+static struct CachedStatement statements[DB_STATEMENT_CACHE_SIZE];
+static unsigned long statementUses;
+static sqlite3 *zobDb;
+
+/**
+ * Returns a prepared statement for `sql` on `db`, compiled on first use and
+ * reused after that: only its bindings and position are reset.
+ *
+ * The statement belongs to the cache. Callers sqlite3_reset() it once done
+ * and never finalize it. It stays valid until DB_STATEMENT_CACHE_SIZE other
+ * statements have been fetched, when the least recently used one is
+ * finalized to make room.
+ *
+ * @return The statement, or NULL if `sql` does not compile.
+ */
+sqlite3_stmt *db_statement(sqlite3 *db, const char *sql) {
+  struct CachedStatement *slot = &statements[0];
+  for (int i = 0; i < DB_STATEMENT_CACHE_SIZE; ++i) {
+    struct CachedStatement *cached = &statements[i];
+    if (cached->stmt && cached->db == db && strcmp(cached->sql, sql) == 0) {
+      cached->lastUse = ++statementUses;
+      sqlite3_reset(cached->stmt);
+      sqlite3_clear_bindings(cached->stmt);
+      return cached->stmt;
+    }
+    if (!slot->stmt) continue;
+    if (!cached->stmt || cached->lastUse < slot->lastUse) slot = cached;
+  }
+
+  sqlite3_stmt *stmt;
+  if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK) {
+    fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+    return NULL;
+  }
+  sqlite3_finalize(slot->stmt);
+  /* The statement keeps its own copy of the text, which the key can point at */
+  *slot = (struct CachedStatement){db, sqlite3_sql(stmt), stmt, ++statementUses};
+  return stmt;
+}
+
+/**
+ * Finalizes the statements cached for `db` and closes it. The connection
+ * returned by db_zob() is closed this way when the process exits.
+ */
+void db_close(sqlite3 *db) {
+  if (!db) return;
+  for (int i = 0; i < DB_STATEMENT_CACHE_SIZE; ++i) {
+    if (statements[i].db != db) continue;
+    sqlite3_finalize(statements[i].stmt);
+    memset(&statements[i], 0, sizeof(statements[i]));
+  }
+  if (db == zobDb) zobDb = NULL;
+  sqlite3_close(db);
+}
+
+/* Whether `db` has a table (or virtual table) called `name` */
+bool db_table_exists(sqlite3 *db, const char *name) {
+  sqlite3_stmt *stmt = db_statement(
+      db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?;");
+  if (!stmt) return false;
+  sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+  bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+  sqlite3_reset(stmt);
+  return exists;
+}
+
+/* Adds a column introduced after the table was first created */
+static int ensureColumn(sqlite3 *db, const char *table, const char *column,
+                        const char *decl) {
+  char sql[256];
+  sqlite3_stmt *stmt;
+  snprintf(sql, sizeof(sql),
+           "SELECT 1 FROM pragma_table_info('%s') WHERE name = ?;", table);
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    return SQLITE_ERROR;
+  sqlite3_bind_text(stmt, 1, column, -1, SQLITE_STATIC);
+  bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+  sqlite3_finalize(stmt);
+  if (exists) return SQLITE_OK;
+
+  snprintf(sql, sizeof(sql), "ALTER TABLE %s ADD COLUMN %s %s;", table, column,
+           decl);
+  return db_execute(db, sql);
+}
+
+/* New feeds start at the fastest cadence and are due immediately */
+static int seedFeeds(sqlite3 *db) {
+  sqlite3_stmt *stmt = db_statement(
+      db,
+      "INSERT INTO Feeds (name, url, poll_interval, next_poll) "
+      "VALUES (?, ?, ?, 0);");
+  if (!stmt) return SQLITE_ERROR;
+  for (int i = 0; i < NUM_PUBLICATIONS; ++i) {
+    sqlite3_bind_text(stmt, 1, publications[i].name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, publications[i].url, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, RSS_POLL_MIN);
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+/**
+ * Schema version 1: every table as it stood before the schema was
+ * versioned. Databases from then already hold some of these, so each is
+ * created only if missing, and Feeds is seeded from the compiled-in
+ * `publications[]` only when it is new.
+ *
+ * Todos holds the todo list.
+ *
+ * RssCache holds the HTTP validators of the last successful fetch of a feed
+ * and RssCacheItems the items parsed from it, so an unchanged feed (304) or
+ * an offline read can be rendered without downloading or parsing anything.
+ * Feeds is the registry of subscribed feeds. RssArticles archives every item
+ * ever fetched, keyed by the item's id so a re-fetched item is stored once.
+ *
+ * FmtCache holds, per absolute path, the stat tuple and content hash of a
+ * file as zob fmt last left it.
+ */
+static int migrateBaseline(sqlite3 *db) {
+  bool newFeeds = !db_table_exists(db, "Feeds");
+  int rc = db_execute(
+      db,
+      "CREATE TABLE IF NOT EXISTS Todos ("
+      "todo_id INTEGER PRIMARY KEY, "
+      "due_date TEXT NOT NULL, "
+      "status TEXT NOT NULL, "
+      "title TEXT NOT NULL, "
+      "description TEXT);"
+      "CREATE TABLE IF NOT EXISTS RssCache ("
+      "url TEXT PRIMARY KEY, "
+      "etag TEXT, "
+      "last_modified TEXT, "
+      "fetched_at INTEGER NOT NULL);"
+      "CREATE TABLE IF NOT EXISTS RssCacheItems ("
+      "url TEXT NOT NULL, "
+      "position INTEGER NOT NULL, "
+      "title TEXT, "
+      "link TEXT, "
+      "description TEXT, "
+      "pub_date TEXT, "
+      "item_id INTEGER, "
+      "PRIMARY KEY (url, position));"
+      "CREATE TABLE IF NOT EXISTS Feeds ("
+      "feed_id INTEGER PRIMARY KEY, "
+      "name TEXT NOT NULL, "
+      "url TEXT NOT NULL UNIQUE, "
+      "poll_interval INTEGER NOT NULL, "
+      "next_poll INTEGER NOT NULL DEFAULT 0, "
+      "newest_link TEXT);"
+      "CREATE TABLE IF NOT EXISTS RssArticles ("
+      "article_id INTEGER PRIMARY KEY, "
+      "feed TEXT NOT NULL, "
+      "title TEXT, "
+      "description TEXT, "
+      "link TEXT, "
+      "pub_date TEXT, "
+      "published INTEGER);"
+      "CREATE TABLE IF NOT EXISTS FmtCache ("
+      "path TEXT PRIMARY KEY, "
+      "mtime INTEGER NOT NULL, "
+      "size INTEGER NOT NULL, "
+      "inode INTEGER NOT NULL, "
+      "hash INTEGER NOT NULL) WITHOUT ROWID;");
+  /* Caches from before items had an id lack the column */
+  if (rc == SQLITE_OK)
+    rc = ensureColumn(db, "RssCacheItems", "item_id", "INTEGER");
+  if (rc == SQLITE_OK && newFeeds) rc = seedFeeds(db);
+  return rc;
+}
+
+/**
+ * Schema version 2: FmtCache records the linter command line each file was
+ * formatted with. Stamps from before get 0, so those files are linted once
+ * more.
+ */
+static int migrateFmtLinter(sqlite3 *db) {
+  return ensureColumn(db, "FmtCache", "linter", "INTEGER NOT NULL DEFAULT 0");
+}
+
+/**
+ * Schema version 3: RssArticlesFts, an FTS5 index over RssArticles
+ * (external content, so the text isn't stored twice), kept in step by a
+ * trigger. Databases from before version 3 got it with the baseline.
+ *
+ * An SQLite built without FTS5 can't create it. That only costs ranked
+ * search, which falls back to LIKE without the table, so the step goes
+ * through without it rather than fail the whole database.
+ */
+static int migrateArticleIndex(sqlite3 *db) {
+  if (db_table_exists(db, "RssArticlesFts")) return SQLITE_OK;
+  int rc = db_execute(db, "SAVEPOINT ArticleIndex;");
+  if (rc != SQLITE_OK) return rc;
+
+  rc = db_execute(
+      db,
+      "CREATE VIRTUAL TABLE RssArticlesFts USING fts5("
+      "title, description, feed, link UNINDEXED, pub_date UNINDEXED, "
+      "content='RssArticles', content_rowid='article_id');"
+      "CREATE TRIGGER RssArticlesIndex AFTER INSERT ON RssArticles "
+      "BEGIN "
+      "INSERT INTO RssArticlesFts (rowid, title, description, feed, link, pub_date) "
+      "VALUES (new.article_id, new.title, new.description, new.feed, new.link, "
+      "new.pub_date); "
+      "END;"
+      /* Articles archived while there was no index */
+      "INSERT INTO RssArticlesFts (RssArticlesFts) VALUES ('rebuild');");
+  if (rc != SQLITE_OK) {
+    fprintf(stderr, "Article search falls back to LIKE: no FTS5 in this SQLite.\n");
+    db_execute(db, "ROLLBACK TO ArticleIndex;");
+  }
+  return db_execute(db, "RELEASE ArticleIndex;");
+}
+
+/**
+ * Schema changes in order: MIGRATIONS[i] takes a database at user_version i
+ * to i + 1. New tables and columns go in a new step at the end, never into
+ * an existing one, which databases in the wild have already run.
+ */
+static int (*const MIGRATIONS[])(sqlite3 *db) = {
+    migrateBaseline,
+    migrateFmtLinter,
+    migrateArticleIndex,
+};
+
+/* Brings the schema up to date, each step in a transaction with its version */
+static int migrate(sqlite3 *db) {
+  const int latest = sizeof(MIGRATIONS) / sizeof(MIGRATIONS[0]);
+  sqlite3_stmt *stmt;
+  int version = 0;
+
+  if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) != SQLITE_OK)
+    return SQLITE_ERROR;
+  if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  while (version < latest) {
+    char sql[64];
+    int rc = db_execute(db, "BEGIN IMMEDIATE;");
+    if (rc != SQLITE_OK) return rc;
+    /* Another process may have migrated while this one waited for the lock */
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) == SQLITE_OK) {
+      if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+      sqlite3_finalize(stmt);
+    }
+    if (version >= latest) return db_execute(db, "COMMIT;");
+
+    rc = MIGRATIONS[version](db);
+    snprintf(sql, sizeof(sql), "PRAGMA user_version = %d;", version + 1);
+    if (rc == SQLITE_OK) rc = db_execute(db, sql);
+    if (rc == SQLITE_OK) rc = db_execute(db, "COMMIT;");
+    if (rc != SQLITE_OK) {
+      db_execute(db, "ROLLBACK;");
+      return rc;
+    }
+    version++;
+  }
+  return SQLITE_OK;
+}
+
+static void closeZobDb(void) { db_close(zobDb); }
+
+/**
+ * The process's connection to the zob database. It is opened on the first
+ * call, which also brings the schema up to date; every later call returns
+ * the same handle. It is closed when the process exits, so callers never
+ * close it themselves.
+ *
+ * @return The connection, or NULL if the database can't be opened or
+ * migrated (the next call tries again).
+ */
+sqlite3 *db_zob(void) {
+  static bool registered;
+  if (zobDb) return zobDb;
+
+  const char *path = db_zob_path();
+  sqlite3 *db;
+  if (!path) return NULL;
+  if (db_open(path, &db) != SQLITE_OK) {
+    sqlite3_close(db);
+    return NULL;
+  }
+
+  /* WAL lets interactive readers work while the rss daemon writes refreshes */
+  sqlite3_busy_timeout(db, 5000);
+  db_execute(db, "PRAGMA journal_mode=WAL;");
+  if (migrate(db) != SQLITE_OK) {
+    db_close(db);
+    return NULL;
+  }
+
+  if (!registered) registered = atexit(closeZobDb) == 0;
+  zobDb = db;
+  return db;
+}
@@ -2,9 +2,15 @@
 #define DB_UTILS_H
 
 #include <sqlite3.h>
+#include <stdbool.h>
 
+const char* db_zob_path(void);
 int db_open(const char* filename, sqlite3** db);
 int db_execute(sqlite3* db, const char* sql);
 int db_query(sqlite3* db, const char* sql, int (*callback)(void*, int, char**, char**), void* data);
+sqlite3* db_zob(void);
+sqlite3_stmt* db_statement(sqlite3* db, const char* sql);
+void db_close(sqlite3* db);
+bool db_table_exists(sqlite3* db, const char* name);
 
 #endif // DB_UTILS_H
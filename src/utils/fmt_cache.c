@@ -0,0 +1,69 @@
+#include "fmt_cache.h"
+
+#include "db_utils.h"
+
+/**
+ * Opens the zob database, whose FmtCache table holds, per absolute path,
+ * the stat tuple and content hash of a file as zob fmt last left it, and the
+ * linter command line it was left by, so a file nobody has touched since is
+ * not linted again with the same linter.
+ */
+int fmtCacheOpen(struct FmtCache *cache) {
+     cache->db = db_zob();
+     return cache->db ? SQLITE_OK : SQLITE_CANTOPEN;
+}
+
+/* The connection is shared and outlives the cache: only the cache lets go of it */
+void fmtCacheClose(struct FmtCache *cache) { cache->db = NULL; }
+
+/**
+ * Looks up the stamp saved for `path`.
+ *
+ * @return true if the file has been formatted before.
+ */
+bool fmtCacheFind(struct FmtCache *cache, const char *path, struct FmtStamp *stamp) {
+     sqlite3_stmt *find;
+     if (!cache->db ||
+         !(find = db_statement(cache->db,
+                               "SELECT mtime, size, inode, hash, linter FROM FmtCache WHERE path = ?;")))
+          return false;
+
+     sqlite3_bind_text(find, 1, path, -1, SQLITE_STATIC);
+     bool found = sqlite3_step(find) == SQLITE_ROW;
+     if (found) {
+          stamp->mtime = sqlite3_column_int64(find, 0);
+          stamp->size = sqlite3_column_int64(find, 1);
+          stamp->inode = (uint64_t)sqlite3_column_int64(find, 2);
+          stamp->hash = (uint64_t)sqlite3_column_int64(find, 3);
+          stamp->linter = (uint64_t)sqlite3_column_int64(find, 4);
+     }
+     sqlite3_reset(find);
+     return found;
+}
+
+/* Saves the stamps of a whole run in one transaction, so it costs a single commit */
+int fmtCacheSave(struct FmtCache *cache, const struct FmtRecord *records, size_t count) {
+     sqlite3_stmt *stmt;
+     if (!cache->db || count == 0) return SQLITE_OK;
+
+     int rc = db_execute(cache->db, "BEGIN;");
+     if (rc != SQLITE_OK) return rc;
+     stmt = db_statement(cache->db,
+                         "INSERT OR REPLACE INTO FmtCache (path, mtime, size, inode, hash, linter) "
+                         "VALUES (?, ?, ?, ?, ?, ?);");
+     if (!stmt) rc = SQLITE_ERROR;
+     for (size_t i = 0; rc == SQLITE_OK && i < count; ++i) {
+          const struct FmtStamp *stamp = &records[i].stamp;
+          sqlite3_bind_text(stmt, 1, records[i].path, -1, SQLITE_STATIC);
+          sqlite3_bind_int64(stmt, 2, stamp->mtime);
+          sqlite3_bind_int64(stmt, 3, stamp->size);
+          sqlite3_bind_int64(stmt, 4, (sqlite3_int64)stamp->inode);
+          sqlite3_bind_int64(stmt, 5, (sqlite3_int64)stamp->hash);
+          sqlite3_bind_int64(stmt, 6, (sqlite3_int64)stamp->linter);
+          if (sqlite3_step(stmt) != SQLITE_DONE) rc = SQLITE_ERROR;
+          sqlite3_reset(stmt);
+     }
+
+     db_execute(cache->db, rc == SQLITE_OK ? "COMMIT;" : "ROLLBACK;");
+     return rc;
+}
@@ -0,0 +1,37 @@
+#ifndef FMT_CACHE_H
+#define FMT_CACHE_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A file as of its last successful format */
+struct FmtStamp {
+     /* Modification time in nanoseconds */
+     int64_t mtime;
+     int64_t size;
+     uint64_t inode;
+     /* hash64() of the contents */
+     uint64_t hash;
+     /* hash64() of the linter's command line, bar the files */
+     uint64_t linter;
+};
+
+/* A stamp to save, for the file at the absolute `path` */
+struct FmtRecord {
+     const char *path;
+     struct FmtStamp stamp;
+};
+
+struct FmtCache {
+     /* The process's zob database connection, NULL without one */
+     sqlite3 *db;
+};
+
+int fmtCacheOpen(struct FmtCache *cache);
+void fmtCacheClose(struct FmtCache *cache);
+bool fmtCacheFind(struct FmtCache *cache, const char *path, struct FmtStamp *stamp);
+int fmtCacheSave(struct FmtCache *cache, const struct FmtRecord *records, size_t count);
+
+#endif  // FMT_CACHE_H
@@ -0,0 +1,81 @@
+#include "hash.h"
+
+#include <string.h>
+
+/* XXH64 (https://github.com/Cyan4973/xxHash), reimplemented to avoid a dependency */
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static uint64_t read64(const unsigned char *p) {
+     uint64_t v;
+     memcpy(&v, p, sizeof(v));
+     return v;
+}
+
+static uint32_t read32(const unsigned char *p) {
+     uint32_t v;
+     memcpy(&v, p, sizeof(v));
+     return v;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input) {
+     acc += input * PRIME2;
+     return rotl(acc, 31) * PRIME1;
+}
+
+static uint64_t merge64(uint64_t acc, uint64_t val) {
+     acc ^= round64(0, val);
+     return acc * PRIME1 + PRIME4;
+}
+
+/**
+ * 64-bit non-cryptographic hash of a buffer (XXH64, little-endian hosts).
+ *
+ * Fast enough to fingerprint whole files and documents, and well enough
+ * distributed to key open-addressed tables with it directly.
+ */
+uint64_t hash64(const void *data, size_t len, uint64_t seed) {
+     const unsigned char *p = data;
+     const unsigned char *end = p + len;
+     uint64_t h;
+
+     if (len >= 32) {
+          uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2, v3 = seed, v4 = seed - PRIME1;
+          do {
+               v1 = round64(v1, read64(p));
+               v2 = round64(v2, read64(p + 8));
+               v3 = round64(v3, read64(p + 16));
+               v4 = round64(v4, read64(p + 24));
+               p += 32;
+          } while (p + 32 <= end);
+
+          h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+          h = merge64(h, v1);
+          h = merge64(h, v2);
+          h = merge64(h, v3);
+          h = merge64(h, v4);
+     } else {
+          h = seed + PRIME5;
+     }
+
+     h += (uint64_t)len;
+     for (; p + 8 <= end; p += 8) h = rotl(h ^ round64(0, read64(p)), 27) * PRIME1 + PRIME4;
+     if (p + 4 <= end) {
+          h = rotl(h ^ (read32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+          p += 4;
+     }
+     for (; p < end; ++p) h = rotl(h ^ (*p * PRIME5), 11) * PRIME1;
+
+     h ^= h >> 33;
+     h *= PRIME2;
+     h ^= h >> 29;
+     h *= PRIME3;
+     h ^= h >> 32;
+     return h;
+}
@@ -0,0 +1,9 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t hash64(const void *data, size_t len, uint64_t seed);
+
+#endif  // HASH_H
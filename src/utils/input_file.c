@@ -0,0 +1,90 @@
+#include "input_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_CHUNK_SIZE (64 * 1024)
+
+/* Reads a stream to its end in chunks, growing the buffer as needed */
+static int readStream(struct InputFile *input, int fd) {
+     size_t capacity = READ_CHUNK_SIZE, length = 0;
+     char *data = malloc(capacity);
+     if (!data) return -1;
+
+     while (1) {
+          if (capacity - length < READ_CHUNK_SIZE) {
+               char *grown = realloc(data, capacity * 2);
+               if (!grown) {
+                    free(data);
+                    return -1;
+               }
+               data = grown;
+               capacity *= 2;
+          }
+          ssize_t got = read(fd, data + length, capacity - length);
+          if (got == 0) break;
+          if (got < 0) {
+               if (errno == EINTR) continue;
+               free(data);
+               return -1;
+          }
+          length += got;
+     }
+
+     input->data = data;
+     input->length = length;
+     input->mapped = false;
+     return 0;
+}
+
+/**
+ * Opens `path` ("-" for stdin) for reading in one piece.
+ *
+ * Regular files are mapped with MADV_SEQUENTIAL, so the kernel reads ahead
+ * aggressively and pages already consumed can be reclaimed first.
+ *
+ * @return 0 on success, -1 on failure with `errno` set.
+ */
+int inputFileOpen(struct InputFile *input, const char *path) {
+     struct stat st;
+     bool useStdin = strcmp(path, "-") == 0;
+     int fd = useStdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+     if (fd < 0) return -1;
+
+     int rc = 0;
+     if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+          void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (map == MAP_FAILED) {
+               rc = -1;
+          } else {
+               madvise(map, st.st_size, MADV_SEQUENTIAL);
+               input->data = map;
+               input->length = st.st_size;
+               input->mapped = true;
+          }
+     } else {
+          rc = readStream(input, fd);
+     }
+
+     if (!useStdin) {
+          int saved = errno;
+          close(fd);
+          errno = saved;
+     }
+     return rc;
+}
+
+void inputFileClose(struct InputFile *input) {
+     if (input->mapped) {
+          munmap((void *)input->data, input->length);
+     } else {
+          free((void *)input->data);
+     }
+     input->data = NULL;
+     input->length = 0;
+}
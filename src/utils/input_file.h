@@ -0,0 +1,21 @@
+#ifndef INPUT_FILE_H
+#define INPUT_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Read-only view of a whole input. Regular files are memory-mapped, so the
+ * contents are never copied; stdin, pipes and other streams are read into
+ * a heap buffer. Either way the data is NOT NUL-terminated.
+ */
+struct InputFile {
+     const char *data;
+     size_t length;
+     bool mapped;
+};
+
+int inputFileOpen(struct InputFile *input, const char *path);
+void inputFileClose(struct InputFile *input);
+
+#endif  // INPUT_FILE_H
@@ -0,0 +1,99 @@
+#include "outbuf.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+bool outBufInit(struct OutBuf *out, int fd, size_t capacity) {
+     out->fd = fd;
+     out->length = 0;
+     out->capacity = capacity;
+     out->failed = false;
+     out->data = malloc(capacity);
+     return out->data != NULL;
+}
+
+/* Points an emptied writer at another descriptor, keeping its buffer */
+void outBufAttach(struct OutBuf *out, int fd) {
+     out->fd = fd;
+     out->length = 0;
+     out->failed = false;
+}
+
+/* Writes all of `data` to the descriptor, riding out short writes */
+static bool writeAll(int fd, const char *data, size_t length) {
+     while (length > 0) {
+          ssize_t written = write(fd, data, length);
+          if (written < 0) {
+               if (errno == EINTR) continue;
+               return false;
+          }
+          data += written;
+          length -= written;
+     }
+     return true;
+}
+
+bool outBufFlush(struct OutBuf *out) {
+     if (out->fd < 0 || out->failed) return !out->failed;
+     if (!writeAll(out->fd, out->data, out->length)) out->failed = true;
+     out->length = 0;
+     return !out->failed;
+}
+
+/* Makes room for `length` more bytes in memory mode */
+static bool reserve(struct OutBuf *out, size_t length) {
+     size_t capacity = out->capacity ? out->capacity : 1;
+     while (capacity - out->length < length) capacity *= 2;
+     if (capacity == out->capacity) return true;
+
+     char *grown = realloc(out->data, capacity);
+     if (!grown) return false;
+     out->data = grown;
+     out->capacity = capacity;
+     return true;
+}
+
+void outBufWrite(struct OutBuf *out, const char *data, size_t length) {
+     if (out->failed) return;
+
+     if (out->fd < 0) {
+          if (!reserve(out, length)) {
+               out->failed = true;
+               return;
+          }
+     } else if (out->capacity - out->length < length) {
+          if (!outBufFlush(out)) return;
+          /* Too big to be worth buffering: hand it straight to the kernel */
+          if (length >= out->capacity) {
+               if (!writeAll(out->fd, data, length)) out->failed = true;
+               return;
+          }
+     }
+     memcpy(out->data + out->length, data, length);
+     out->length += length;
+}
+
+void outBufPuts(struct OutBuf *out, const char *str) { outBufWrite(out, str, strlen(str)); }
+
+/**
+ * Hands over a memory buffer's contents as a NUL-terminated string the
+ * caller frees, leaving the writer empty.
+ *
+ * @return The string, or NULL if a write failed along the way.
+ */
+char *outBufRelease(struct OutBuf *out) {
+     outBufWrite(out, "", 1);
+     char *data = out->failed ? NULL : out->data;
+     if (!data) free(out->data);
+     out->data = NULL;
+     out->length = out->capacity = 0;
+     return data;
+}
+
+void outBufFree(struct OutBuf *out) {
+     free(out->data);
+     out->data = NULL;
+     out->length = out->capacity = 0;
+}
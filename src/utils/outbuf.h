@@ -0,0 +1,29 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Buffered writer. With a file descriptor it flushes whenever the buffer
+ * fills, so memory stays at `capacity` however much is written; with
+ * fd -1 it grows to hold everything, for callers that want a string.
+ */
+struct OutBuf {
+     int fd;
+     char *data;
+     size_t length;
+     size_t capacity;
+     /* Set on the first failed write or allocation; later writes are dropped */
+     bool failed;
+};
+
+bool outBufInit(struct OutBuf *out, int fd, size_t capacity);
+void outBufAttach(struct OutBuf *out, int fd);
+void outBufWrite(struct OutBuf *out, const char *data, size_t length);
+void outBufPuts(struct OutBuf *out, const char *str);
+bool outBufFlush(struct OutBuf *out);
+char *outBufRelease(struct OutBuf *out);
+void outBufFree(struct OutBuf *out);
+
+#endif  // OUTBUF_H
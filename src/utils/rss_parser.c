@@ -0,0 +1,264 @@
+#define _GNU_SOURCE
+#include "rss_parser.h"
+
+#include "hash.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+enum { STATE_TEXT, STATE_TAG, STATE_CDATA, STATE_COMMENT };
+
+enum { FIELD_NONE, FIELD_TITLE, FIELD_LINK, FIELD_DESCRIPTION, FIELD_PUBDATE, FIELD_GUID };
+
+void rssParserInit(struct RssParser *parser, RssItemCallback onItem, void *userdata) {
+     memset(parser, 0, sizeof(*parser));
+     parser->onItem = onItem;
+     parser->userdata = userdata;
+}
+
+/* Buffer and capacity of the field currently being read */
+static char *fieldBuffer(struct RssParser *parser, size_t *size) {
+     switch (parser->field) {
+          case FIELD_TITLE:
+               *size = sizeof(parser->item.title);
+               return parser->item.title;
+          case FIELD_LINK:
+               *size = sizeof(parser->item.link);
+               return parser->item.link;
+          case FIELD_DESCRIPTION:
+               *size = sizeof(parser->item.description);
+               return parser->item.description;
+          case FIELD_PUBDATE:
+               *size = sizeof(parser->pubDate);
+               return parser->pubDate;
+          case FIELD_GUID:
+               *size = sizeof(parser->guid);
+               return parser->guid;
+     }
+     return NULL;
+}
+
+/* Appends text to the current field, silently truncating what doesn't fit */
+static void appendField(struct RssParser *parser, const char *text, size_t len) {
+     size_t size;
+     char *buffer = fieldBuffer(parser, &size);
+     if (!buffer || parser->fieldLen + 1 >= size) return;
+
+     if (len > size - 1 - parser->fieldLen) len = size - 1 - parser->fieldLen;
+     memcpy(buffer + parser->fieldLen, text, len);
+     parser->fieldLen += len;
+     buffer[parser->fieldLen] = '\0';
+}
+
+static void trimInPlace(char *str) {
+     char *start = str;
+     while (isspace((unsigned char)*start)) start++;
+
+     size_t len = strlen(start);
+     while (len > 0 && isspace((unsigned char)start[len - 1])) len--;
+
+     memmove(str, start, len);
+     str[len] = '\0';
+}
+
+static void emitItem(struct RssParser *parser) {
+     struct RssItem *item = &parser->item;
+     int day, year;
+     char month[20];
+
+     trimInPlace(item->title);
+     trimInPlace(item->link);
+     trimInPlace(item->description);
+     trimInPlace(parser->guid);
+
+     const char *identity = parser->guid[0] ? parser->guid : item->link;
+     item->id = hash64(identity, strlen(identity), 0);
+
+     /* All the big sites use <pubDate>Thu, 14 Mar 2024 20:25:28 +0000</pubDate>
+      * ... I only want DD <Month> YYYY
+      */
+     item->pubDate[0] = '\0';
+     if (sscanf(parser->pubDate, "%*[^,], %d %19s %d", &day, month, &year) == 3) {
+          snprintf(item->pubDate, sizeof(item->pubDate), "%d %s %d", day, month, year);
+     }
+
+     /* Numeric zones are honoured; named ones ("GMT", "EST") are taken as UTC */
+     struct tm tm = {0};
+     const char *rest = strptime(parser->pubDate, " %a, %d %b %Y %H:%M:%S", &tm);
+     item->published = 0;
+     if (rest) {
+          struct tm zone = {0};
+          item->published = timegm(&tm);
+          if (strptime(rest, " %z", &zone)) item->published -= zone.tm_gmtoff;
+     }
+
+     parser->count++;
+     if (parser->onItem) parser->onItem(item, parser->userdata);
+}
+
+static int fieldForTag(const char *name) {
+     if (strcmp(name, "title") == 0) return FIELD_TITLE;
+     if (strcmp(name, "link") == 0) return FIELD_LINK;
+     if (strcmp(name, "description") == 0) return FIELD_DESCRIPTION;
+     if (strcmp(name, "pubDate") == 0) return FIELD_PUBDATE;
+     if (strcmp(name, "guid") == 0) return FIELD_GUID;
+     return FIELD_NONE;
+}
+
+/* Acts on a complete tag; `parser->tag` holds its (possibly truncated) name */
+static void handleTag(struct RssParser *parser) {
+     const char *name = parser->tag;
+     bool closing = name[0] == '/';
+     if (closing) name++;
+
+     if (strcmp(name, "item") == 0) {
+          if (closing && parser->inItem) {
+               parser->inItem = false;
+               parser->field = FIELD_NONE;
+               emitItem(parser);
+          } else if (!closing && !parser->selfClosing) {
+               memset(&parser->item, 0, sizeof(parser->item));
+               parser->pubDate[0] = parser->guid[0] = '\0';
+               parser->inItem = true;
+               parser->field = FIELD_NONE;
+          }
+          return;
+     }
+     if (!parser->inItem) return;
+
+     int field = fieldForTag(name);
+     if (field == FIELD_NONE) return;
+     if (closing || parser->selfClosing) {
+          if (field == parser->field) parser->field = FIELD_NONE;
+          return;
+     }
+
+     /* Like the first-match lookup it replaces, the first occurrence wins */
+     size_t size;
+     parser->field = field;
+     if (fieldBuffer(parser, &size)[0] != '\0') {
+          parser->field = FIELD_NONE;
+          return;
+     }
+     parser->fieldLen = 0;
+}
+
+/* Index of the next `c` at or after `from`, or `len`: memchr is vectorized by libc */
+static size_t scanTo(const char *chunk, size_t from, size_t len, char c) {
+     const char *hit = memchr(chunk + from, c, len - from);
+     return hit ? (size_t)(hit - chunk) : len;
+}
+
+/**
+ * Feeds the next chunk of an RSS document to the parser.
+ *
+ * Tags, CDATA sections and comments may be split anywhere across chunks.
+ * Every <item> is handed to the callback as soon as it closes.
+ *
+ * The chunk is swept once, front to back: text, CDATA and comment bodies
+ * are skipped a run at a time up to the next byte that can change state
+ * ('<', ']' or '-'), and runs inside a field are copied in one go. Only tag
+ * names are looked at byte by byte.
+ *
+ * @return false once MAX_ARTICLES items have been produced, so the caller
+ * can stop the transfer early.
+ */
+bool parse_rss(struct RssParser *parser, const char *chunk, size_t len) {
+     size_t i = 0;
+
+     while (i < len && parser->count < MAX_ARTICLES) {
+          size_t end;
+          char c;
+
+          switch (parser->state) {
+               case STATE_TEXT:
+                    end = scanTo(chunk, i, len, '<');
+                    appendField(parser, chunk + i, end - i);
+                    i = end;
+                    if (i == len) break;
+
+                    parser->state = STATE_TAG;
+                    parser->tagLen = 0;
+                    parser->tag[0] = '\0';
+                    parser->nameDone = false;
+                    parser->selfClosing = false;
+                    i++;
+                    break;
+
+               case STATE_TAG:
+                    /* Past the name, attributes are skipped wholesale */
+                    if (parser->nameDone) {
+                         end = scanTo(chunk, i, len, '>');
+                         if (end > i) parser->selfClosing = chunk[end - 1] == '/';
+                         i = end;
+                         if (i == len) break;
+                    }
+
+                    c = chunk[i++];
+                    if (c == '>') {
+                         parser->state = STATE_TEXT;
+                         handleTag(parser);
+                         break;
+                    }
+                    parser->selfClosing = c == '/';
+                    /* Only the name matters: stop recording at the first attribute */
+                    if (isspace((unsigned char)c) || (c == '/' && parser->tagLen > 0)) {
+                         parser->nameDone = true;
+                         break;
+                    }
+                    if (parser->tagLen < sizeof(parser->tag) - 1) {
+                         parser->tag[parser->tagLen++] = c;
+                         parser->tag[parser->tagLen] = '\0';
+                    }
+                    if (strcmp(parser->tag, "![CDATA[") == 0) {
+                         parser->state = STATE_CDATA;
+                         parser->match = 0;
+                    } else if (strcmp(parser->tag, "!--") == 0) {
+                         parser->state = STATE_COMMENT;
+                         parser->match = 0;
+                    }
+                    break;
+
+               case STATE_CDATA:
+                    if (parser->match == 0) {
+                         end = scanTo(chunk, i, len, ']');
+                         appendField(parser, chunk + i, end - i);
+                         i = end;
+                         if (i == len) break;
+                    }
+
+                    c = chunk[i++];
+                    if (c == ']' && parser->match < 2) {
+                         parser->match++;
+                    } else if (c == '>' && parser->match == 2) {
+                         parser->state = STATE_TEXT;
+                    } else if (c == ']') {
+                         /* Brackets that turned out not to close the section are content */
+                         appendField(parser, "]", 1);
+                    } else {
+                         appendField(parser, "]]", parser->match);
+                         parser->match = 0;
+                         appendField(parser, &c, 1);
+                    }
+                    break;
+
+               case STATE_COMMENT:
+                    if (parser->match == 0) {
+                         i = scanTo(chunk, i, len, '-');
+                         if (i == len) break;
+                    }
+
+                    c = chunk[i++];
+                    if (c == '-') {
+                         if (parser->match < 2) parser->match++;
+                    } else {
+                         if (c == '>' && parser->match == 2) parser->state = STATE_TEXT;
+                         parser->match = 0;
+                    }
+                    break;
+          }
+     }
+
+     return parser->count < MAX_ARTICLES;
+}
@@ -0,0 +1,60 @@
+#ifndef RSS_PARSER_H
+#define RSS_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../config.h"
+
+struct RssItem {
+     char title[512];
+     char link[512];
+     char description[1024];
+     /* In format: DD <Month> YYYY */
+     char pubDate[20];
+     /* pubDate as a UTC timestamp, 0 when it could not be parsed */
+     time_t published;
+     /* Hash of the <guid>, or of the link when there is none: the item's identity */
+     uint64_t id;
+};
+
+struct RssFeed {
+     struct RssItem items[MAX_ARTICLES];
+     int count;
+};
+
+typedef void (*RssItemCallback)(const struct RssItem *item, void *userdata);
+
+/**
+ * Resumable RSS parser state.
+ *
+ * The parser is fed the document in arbitrary chunks (as curl delivers them)
+ * and keeps just enough state to resume mid-tag or mid-CDATA, so memory is
+ * bounded by one item regardless of the size of the feed.
+ */
+struct RssParser {
+     int state;
+     /* Name of the tag being read, truncated to what we need to match */
+     char tag[16];
+     size_t tagLen;
+     bool nameDone;
+     bool selfClosing;
+     /* Progress through a "]]>" or "-->" terminator split across chunks */
+     int match;
+     bool inItem;
+     int field;
+     size_t fieldLen;
+     char pubDate[64];
+     char guid[512];
+     struct RssItem item;
+     int count;
+     RssItemCallback onItem;
+     void *userdata;
+};
+
+void rssParserInit(struct RssParser *parser, RssItemCallback onItem, void *userdata);
+bool parse_rss(struct RssParser *parser, const char *chunk, size_t len);
+
+#endif  // RSS_PARSER_H
@@ -0,0 +1,436 @@
+#include "rss_store.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "db_utils.h"
+#include "hash.h"
+
+/* Copies a possibly NULL text column into a fixed-size buffer */
+static void copyColumn(sqlite3_stmt *stmt, int col, char *dst, size_t size) {
+     const unsigned char *text = sqlite3_column_text(stmt, col);
+     snprintf(dst, size, "%s", text ? (const char *)text : "");
+}
+
+/**
+ * Opens the zob database, whose RSS tables (RssCache and RssCacheItems for
+ * conditional GETs and offline reads, the Feeds registry, the RssArticles
+ * archive and, where SQLite has FTS5, its index) are set up by db_zob()'s
+ * migrations.
+ *
+ * The connection is the process's shared one: it is never closed here.
+ */
+int rssStoreOpen(sqlite3 **db) {
+     *db = db_zob();
+     return *db ? SQLITE_OK : SQLITE_CANTOPEN;
+}
+
+/**
+ * Looks up the ETag and Last-Modified stored for a feed.
+ *
+ * @return 1 if the feed has been cached before, 0 otherwise.
+ */
+int rssCacheValidators(sqlite3 *db, const char *url, char *etag, size_t etagSize,
+                       char *lastModified, size_t lastModifiedSize) {
+     etag[0] = lastModified[0] = '\0';
+     sqlite3_stmt *stmt =
+         db_statement(db, "SELECT etag, last_modified FROM RssCache WHERE url = ?;");
+     if (!stmt) return 0;
+
+     sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+     int found = sqlite3_step(stmt) == SQLITE_ROW;
+     if (found) {
+          copyColumn(stmt, 0, etag, etagSize);
+          copyColumn(stmt, 1, lastModified, lastModifiedSize);
+     }
+     sqlite3_reset(stmt);
+     return found;
+}
+
+/**
+ * Loads the cached items of a feed, in their original order.
+ *
+ * @return The number of items loaded into `feed`.
+ */
+int rssCacheItems(sqlite3 *db, const char *url, struct RssFeed *feed) {
+     feed->count = 0;
+     sqlite3_stmt *stmt = db_statement(db,
+                                       "SELECT title, link, description, pub_date, item_id "
+                                       "FROM RssCacheItems WHERE url = ? "
+                                       "ORDER BY position LIMIT ?;");
+     if (!stmt) return 0;
+
+     sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+     sqlite3_bind_int(stmt, 2, MAX_ARTICLES);
+     while (sqlite3_step(stmt) == SQLITE_ROW) {
+          struct RssItem *item = &feed->items[feed->count++];
+          copyColumn(stmt, 0, item->title, sizeof(item->title));
+          copyColumn(stmt, 1, item->link, sizeof(item->link));
+          copyColumn(stmt, 2, item->description, sizeof(item->description));
+          copyColumn(stmt, 3, item->pubDate, sizeof(item->pubDate));
+          /* Rows cached before items had an id fall back to the link, as the parser does */
+          if (sqlite3_column_type(stmt, 4) == SQLITE_NULL)
+               item->id = hash64(item->link, strlen(item->link), 0);
+          else
+               item->id = (uint64_t)sqlite3_column_int64(stmt, 4);
+     }
+     sqlite3_reset(stmt);
+     return feed->count;
+}
+
+/**
+ * Replaces the cached validators and items of a feed and archives any items
+ * not seen before, all in one transaction so indexing costs a single commit.
+ */
+int rssCacheSave(sqlite3 *db, const char *name, const char *url, const char *etag,
+                 const char *lastModified, const struct RssFeed *feed) {
+     sqlite3_stmt *stmt;
+     int rc = db_execute(db, "BEGIN;");
+     if (rc != SQLITE_OK) return rc;
+
+     stmt = db_statement(db,
+                         "INSERT OR REPLACE INTO RssCache (url, etag, last_modified, fetched_at) "
+                         "VALUES (?, ?, ?, ?);");
+     rc = stmt ? SQLITE_OK : SQLITE_ERROR;
+     if (rc == SQLITE_OK) {
+          sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+          sqlite3_bind_text(stmt, 2, etag, -1, SQLITE_STATIC);
+          sqlite3_bind_text(stmt, 3, lastModified, -1, SQLITE_STATIC);
+          sqlite3_bind_int64(stmt, 4, (sqlite3_int64)time(NULL));
+          rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+          sqlite3_reset(stmt);
+     }
+
+     if (rc == SQLITE_OK) {
+          stmt = db_statement(db, "DELETE FROM RssCacheItems WHERE url = ?;");
+          rc = stmt ? SQLITE_OK : SQLITE_ERROR;
+          if (rc == SQLITE_OK) {
+               sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+               rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+               sqlite3_reset(stmt);
+          }
+     }
+
+     sqlite3_stmt *insert = NULL;
+     if (rc == SQLITE_OK) {
+          insert = db_statement(db,
+                                "INSERT INTO RssCacheItems "
+                                "(url, position, title, link, description, pub_date, item_id) "
+                                "VALUES (?, ?, ?, ?, ?, ?, ?);");
+          rc = insert ? SQLITE_OK : SQLITE_ERROR;
+     }
+     for (int i = 0; rc == SQLITE_OK && i < feed->count; ++i) {
+          const struct RssItem *item = &feed->items[i];
+          sqlite3_bind_text(insert, 1, url, -1, SQLITE_STATIC);
+          sqlite3_bind_int(insert, 2, i);
+          sqlite3_bind_text(insert, 3, item->title, -1, SQLITE_STATIC);
+          sqlite3_bind_text(insert, 4, item->link, -1, SQLITE_STATIC);
+          sqlite3_bind_text(insert, 5, item->description, -1, SQLITE_STATIC);
+          sqlite3_bind_text(insert, 6, item->pubDate, -1, SQLITE_STATIC);
+          sqlite3_bind_int64(insert, 7, (sqlite3_int64)item->id);
+          if (sqlite3_step(insert) != SQLITE_DONE) rc = SQLITE_ERROR;
+          sqlite3_reset(insert);
+     }
+
+     /* Items already archived keep their row; only new ones reach the index */
+     insert = NULL;
+     if (rc == SQLITE_OK) {
+          insert = db_statement(db,
+                                "INSERT OR IGNORE INTO RssArticles "
+                                "(article_id, feed, title, description, link, pub_date, published) "
+                                "VALUES (?, ?, ?, ?, ?, ?, ?);");
+          rc = insert ? SQLITE_OK : SQLITE_ERROR;
+     }
+     for (int i = 0; rc == SQLITE_OK && i < feed->count; ++i) {
+          const struct RssItem *item = &feed->items[i];
+          sqlite3_bind_int64(insert, 1, (sqlite3_int64)item->id);
+          sqlite3_bind_text(insert, 2, name, -1, SQLITE_STATIC);
+          sqlite3_bind_text(insert, 3, item->title, -1, SQLITE_STATIC);
+          sqlite3_bind_text(insert, 4, item->description, -1, SQLITE_STATIC);
+          sqlite3_bind_text(insert, 5, item->link, -1, SQLITE_STATIC);
+          sqlite3_bind_text(insert, 6, item->pubDate, -1, SQLITE_STATIC);
+          sqlite3_bind_int64(insert, 7, (sqlite3_int64)item->published);
+          if (sqlite3_step(insert) != SQLITE_DONE) rc = SQLITE_ERROR;
+          sqlite3_reset(insert);
+     }
+
+     if (rc != SQLITE_OK) {
+          fprintf(stderr, "Failed to cache feed: %s\n", sqlite3_errmsg(db));
+          db_execute(db, "ROLLBACK;");
+          return rc;
+     }
+     return db_execute(db, "COMMIT;");
+}
+
+/**
+ * Loads the feed registry, optionally only the feeds whose next poll is due.
+ *
+ * @param subs Receives a malloc'd array the caller frees.
+ */
+int rssFeedsLoad(sqlite3 *db, bool dueOnly, time_t now, struct Subscription **subs, int *count) {
+     int capacity = 16, rc;
+     *count = 0;
+     *subs = malloc(capacity * sizeof(struct Subscription));
+     if (!*subs) return SQLITE_NOMEM;
+
+     sqlite3_stmt *stmt = db_statement(db,
+                                       "SELECT feed_id, name, url, poll_interval, next_poll "
+                                       "FROM Feeds WHERE ?1 = 0 OR next_poll <= ?2 "
+                                       "ORDER BY feed_id;");
+     if (!stmt) return SQLITE_ERROR;
+
+     sqlite3_bind_int(stmt, 1, dueOnly);
+     sqlite3_bind_int64(stmt, 2, (sqlite3_int64)now);
+     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+          if (*count == capacity) {
+               struct Subscription *grown = realloc(*subs, 2 * capacity * sizeof(**subs));
+               if (!grown) {
+                    rc = SQLITE_NOMEM;
+                    break;
+               }
+               *subs = grown;
+               capacity *= 2;
+          }
+          struct Subscription *sub = &(*subs)[(*count)++];
+          sub->id = sqlite3_column_int(stmt, 0);
+          copyColumn(stmt, 1, sub->name, sizeof(sub->name));
+          copyColumn(stmt, 2, sub->url, sizeof(sub->url));
+          sub->interval = (long)sqlite3_column_int64(stmt, 3);
+          sub->nextPoll = (time_t)sqlite3_column_int64(stmt, 4);
+     }
+     sqlite3_reset(stmt);
+     return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+/**
+ * Earliest next poll across the registry.
+ *
+ * @return The timestamp, or 0 if there are no feeds.
+ */
+time_t rssFeedsNextPoll(sqlite3 *db) {
+     time_t next = 0;
+     sqlite3_stmt *stmt = db_statement(db, "SELECT MIN(next_poll) FROM Feeds;");
+     if (!stmt) return 0;
+     if (sqlite3_step(stmt) == SQLITE_ROW) next = (time_t)sqlite3_column_int64(stmt, 0);
+     sqlite3_reset(stmt);
+     return next;
+}
+
+/* New feeds start at the fastest cadence and are due immediately */
+int rssFeedAdd(sqlite3 *db, const char *name, const char *url) {
+     sqlite3_stmt *stmt = db_statement(db,
+                                       "INSERT INTO Feeds (name, url, poll_interval, next_poll) "
+                                       "VALUES (?, ?, ?, 0);");
+     if (!stmt) return SQLITE_ERROR;
+
+     sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+     sqlite3_bind_text(stmt, 2, url, -1, SQLITE_STATIC);
+     sqlite3_bind_int64(stmt, 3, RSS_POLL_MIN);
+     int rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+     sqlite3_reset(stmt);
+     return rc;
+}
+
+/**
+ * Removes a feed from the registry along with everything cached for it.
+ *
+ * @return SQLITE_OK if the feed existed, SQLITE_NOTFOUND otherwise.
+ */
+int rssFeedRemove(sqlite3 *db, int id) {
+     sqlite3_stmt *stmt;
+     int rc;
+     const char *sql[] = {
+         "DELETE FROM RssCache WHERE url = (SELECT url FROM Feeds WHERE feed_id = ?);",
+         "DELETE FROM RssCacheItems WHERE url = (SELECT url FROM Feeds WHERE feed_id = ?);",
+         "DELETE FROM Feeds WHERE feed_id = ?;",
+     };
+     for (size_t i = 0; i < sizeof(sql) / sizeof(sql[0]); ++i) {
+          if (!(stmt = db_statement(db, sql[i]))) return SQLITE_ERROR;
+          sqlite3_bind_int(stmt, 1, id);
+          rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+          sqlite3_reset(stmt);
+          if (rc != SQLITE_OK) return rc;
+     }
+     return sqlite3_changes(db) > 0 ? SQLITE_OK : SQLITE_NOTFOUND;
+}
+
+/* Mean gap between the newest and oldest dated items, 0 if it can't be told */
+static long publishCadence(const struct RssFeed *feed) {
+     time_t newest = 0, oldest = 0;
+     int dated = 0;
+     for (int i = 0; i < feed->count; ++i) {
+          time_t published = feed->items[i].published;
+          if (!published) continue;
+          if (!dated || published > newest) newest = published;
+          if (!dated || published < oldest) oldest = published;
+          dated++;
+     }
+     return dated > 1 ? (long)((newest - oldest) / (dated - 1)) : 0;
+}
+
+/**
+ * Sets a feed's next poll time after a fetch.
+ *
+ * A feed that changed is polled at about half its observed publishing
+ * cadence; one that didn't (a 304, `feed` NULL, or the same newest item)
+ * backs off exponentially, and so does one whose fetch `failed`, so a dead
+ * feed is tried less and less often instead of staying due. Both are
+ * clamped to [RSS_POLL_MIN, RSS_POLL_MAX].
+ */
+int rssFeedSchedule(sqlite3 *db, const char *url, const struct RssFeed *feed, bool failed,
+                    time_t now) {
+     sqlite3_stmt *stmt;
+     char newestLink[512] = {0};
+     long interval = RSS_POLL_MIN;
+
+     stmt = db_statement(db, "SELECT poll_interval, newest_link FROM Feeds WHERE url = ?;");
+     if (!stmt) return SQLITE_ERROR;
+     sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+     if (sqlite3_step(stmt) != SQLITE_ROW) {
+          /* Not in the registry: nothing to schedule */
+          sqlite3_reset(stmt);
+          return SQLITE_OK;
+     }
+     interval = (long)sqlite3_column_int64(stmt, 0);
+     copyColumn(stmt, 1, newestLink, sizeof(newestLink));
+     sqlite3_reset(stmt);
+
+     bool changed = !failed && feed && feed->count > 0 && strcmp(feed->items[0].link, newestLink) != 0;
+     if (changed) {
+          long cadence = publishCadence(feed);
+          if (cadence > 0) interval = cadence / 2;
+          snprintf(newestLink, sizeof(newestLink), "%s", feed->items[0].link);
+     } else {
+          interval *= 2;
+     }
+     if (interval < RSS_POLL_MIN) interval = RSS_POLL_MIN;
+     if (interval > RSS_POLL_MAX) interval = RSS_POLL_MAX;
+
+     stmt = db_statement(db,
+                         "UPDATE Feeds SET poll_interval = ?, next_poll = ?, newest_link = ? "
+                         "WHERE url = ?;");
+     if (!stmt) return SQLITE_ERROR;
+     sqlite3_bind_int64(stmt, 1, interval);
+     sqlite3_bind_int64(stmt, 2, (sqlite3_int64)(now + interval));
+     sqlite3_bind_text(stmt, 3, newestLink, -1, SQLITE_STATIC);
+     sqlite3_bind_text(stmt, 4, url, -1, SQLITE_STATIC);
+     int rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+     sqlite3_reset(stmt);
+     return rc;
+}
+
+/* Runs a prepared search, handing each row to the callback */
+static int searchStep(sqlite3_stmt *stmt, RssSearchCallback onHit, void *userdata) {
+     struct RssSearchHit hit;
+     int rc, hits = 0;
+     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+          copyColumn(stmt, 0, hit.feed, sizeof(hit.feed));
+          copyColumn(stmt, 1, hit.title, sizeof(hit.title));
+          copyColumn(stmt, 2, hit.link, sizeof(hit.link));
+          copyColumn(stmt, 3, hit.pubDate, sizeof(hit.pubDate));
+          copyColumn(stmt, 4, hit.snippet, sizeof(hit.snippet));
+          onHit(&hit, userdata);
+          hits++;
+     }
+     return rc == SQLITE_DONE ? hits : -1;
+}
+
+/* Quotes every whitespace-separated term, so punctuation is taken literally */
+static char *quoteTerms(const char *query) {
+     size_t len = strlen(query);
+     /* Worst case every character is a quote: doubled, and a term of its own with a pair */
+     char *quoted = malloc(4 * len + 3);
+     if (!quoted) return NULL;
+
+     char *out = quoted;
+     bool inTerm = false;
+     for (const char *c = query;; ++c) {
+          bool space = *c == '\0' || isspace((unsigned char)*c);
+          if (inTerm && space) *out++ = '"';
+          if (*c == '\0') break;
+          if (!inTerm && !space) *out++ = '"';
+          if (*c == '"') *out++ = '"';
+          *out++ = *c;
+          inTerm = !space;
+     }
+     *out = '\0';
+     return quoted;
+}
+
+/**
+ * Search for SQLite without FTS5, where the archive has no index: articles
+ * whose title or description holds the query as typed, newest first.
+ */
+static int likeSearch(sqlite3 *db, const char *query, int limit, RssSearchCallback onHit,
+                      void *userdata) {
+     sqlite3_stmt *stmt = db_statement(
+         db,
+         "SELECT feed, title, link, pub_date, substr(description, 1, 160) "
+         "FROM RssArticles "
+         "WHERE title LIKE ?1 ESCAPE '\\' OR description LIKE ?1 ESCAPE '\\' "
+         "ORDER BY published DESC LIMIT ?2;");
+     /* The query between wildcards, its own wildcards and escapes escaped */
+     char *pattern = malloc(2 * strlen(query) + 3);
+     if (!stmt || !pattern) {
+          free(pattern);
+          return -1;
+     }
+
+     char *out = pattern;
+     *out++ = '%';
+     for (const char *c = query; *c; ++c) {
+          if (*c == '%' || *c == '_' || *c == '\\') *out++ = '\\';
+          *out++ = *c;
+     }
+     *out++ = '%';
+     *out = '\0';
+
+     sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_STATIC);
+     sqlite3_bind_int(stmt, 2, limit);
+     int hits = searchStep(stmt, onHit, userdata);
+     sqlite3_reset(stmt);
+     free(pattern);
+     return hits;
+}
+
+/**
+ * Full-text search over the article archive, best matches first.
+ *
+ * Titles weigh more than descriptions in the bm25 ranking. The query is
+ * FTS5 syntax (`rust OR zig`, `"exact phrase"`, `title:election`); if it
+ * doesn't parse as such, it is retried with every term taken literally.
+ * Without the FTS5 index, it falls back to likeSearch().
+ *
+ * @return The number of hits, or -1 on error.
+ */
+int rssArchiveSearch(sqlite3 *db, const char *query, int limit, RssSearchCallback onHit,
+                     void *userdata) {
+     if (!db_table_exists(db, "RssArticlesFts"))
+          return likeSearch(db, query, limit, onHit, userdata);
+
+     sqlite3_stmt *stmt = db_statement(
+         db,
+         "SELECT a.feed, a.title, a.link, a.pub_date, "
+         "snippet(RssArticlesFts, -1, '\033[1m', '\033[0m', '…', 24) "
+         "FROM RssArticlesFts JOIN RssArticles a ON a.article_id = RssArticlesFts.rowid "
+         "WHERE RssArticlesFts MATCH ? "
+         "ORDER BY bm25(RssArticlesFts, 10.0, 1.0, 2.0) LIMIT ?;");
+     if (!stmt) return -1;
+
+     sqlite3_bind_text(stmt, 1, query, -1, SQLITE_STATIC);
+     sqlite3_bind_int(stmt, 2, limit);
+     int hits = searchStep(stmt, onHit, userdata);
+
+     char *quoted = NULL;
+     if (hits < 0 && (quoted = quoteTerms(query))) {
+          sqlite3_reset(stmt);
+          sqlite3_bind_text(stmt, 1, quoted, -1, SQLITE_STATIC);
+          hits = searchStep(stmt, onHit, userdata);
+     }
+     sqlite3_reset(stmt);
+     free(quoted);
+     return hits;
+}
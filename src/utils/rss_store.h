@@ -0,0 +1,46 @@
+#ifndef RSS_STORE_H
+#define RSS_STORE_H
+
+#include <sqlite3.h>
+#include <stddef.h>
+
+#include "rss_parser.h"
+
+/* A feed in the runtime registry, with its polling schedule */
+struct Subscription {
+     int id;
+     char name[128];
+     char url[512];
+     /* Seconds between polls, adapted to how often the feed publishes */
+     long interval;
+     time_t nextPoll;
+};
+
+/* One ranked match from the article archive */
+struct RssSearchHit {
+     char feed[128];
+     char title[512];
+     char link[512];
+     char pubDate[20];
+     /* Best matching fragment, with the matched terms in bold */
+     char snippet[512];
+};
+
+typedef void (*RssSearchCallback)(const struct RssSearchHit *hit, void *userdata);
+
+int rssStoreOpen(sqlite3 **db);
+int rssFeedsLoad(sqlite3 *db, bool dueOnly, time_t now, struct Subscription **subs, int *count);
+time_t rssFeedsNextPoll(sqlite3 *db);
+int rssFeedAdd(sqlite3 *db, const char *name, const char *url);
+int rssFeedRemove(sqlite3 *db, int id);
+int rssFeedSchedule(sqlite3 *db, const char *url, const struct RssFeed *feed, bool failed,
+                    time_t now);
+int rssCacheValidators(sqlite3 *db, const char *url, char *etag, size_t etagSize,
+                       char *lastModified, size_t lastModifiedSize);
+int rssCacheItems(sqlite3 *db, const char *url, struct RssFeed *feed);
+int rssCacheSave(sqlite3 *db, const char *name, const char *url, const char *etag,
+                 const char *lastModified, const struct RssFeed *feed);
+int rssArchiveSearch(sqlite3 *db, const char *query, int limit, RssSearchCallback onHit,
+                     void *userdata);
+
+#endif  // RSS_STORE_H
@@ -0,0 +1,171 @@
+#include "seen_set.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Header words preceding the slots */
+#define SEEN_MAGIC 0x314E454553424F5AULL /* "ZOBSEEN1" */
+#define HEADER_MAGIC 0
+#define HEADER_CAPACITY 1
+#define HEADER_COUNT 2
+#define HEADER_WORDS 3
+
+#define INITIAL_CAPACITY 4096
+
+/* 0 marks an empty slot, so it is remapped to a value that can be stored */
+static uint64_t slotKey(uint64_t hash) { return hash ? hash : 1; }
+
+static uint64_t *slots(const struct SeenSet *set) { return set->map + HEADER_WORDS; }
+
+static uint64_t capacity(const struct SeenSet *set) { return set->map[HEADER_CAPACITY]; }
+
+/* Maps `fd` as a set of `cap` slots, laying out a fresh header if `init` */
+static int mapFile(struct SeenSet *set, int fd, uint64_t cap, bool init) {
+     size_t size = (HEADER_WORDS + cap) * sizeof(uint64_t);
+     if (init && ftruncate(fd, size) != 0) return -1;
+
+     uint64_t *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+     if (map == MAP_FAILED) return -1;
+
+     if (init) {
+          map[HEADER_MAGIC] = SEEN_MAGIC;
+          map[HEADER_CAPACITY] = cap;
+          map[HEADER_COUNT] = 0;
+     }
+     set->fd = fd;
+     set->map = map;
+     set->mapSize = size;
+     return 0;
+}
+
+/**
+ * Whether a file of `fileSize` bytes starting with `header` is a set that
+ * can be probed: a power-of-two capacity the file is exactly sized for, and
+ * fewer entries than slots, so every probe sequence reaches an empty slot.
+ */
+static bool validHeader(const uint64_t *header, off_t fileSize) {
+     uint64_t cap = header[HEADER_CAPACITY];
+     if (header[HEADER_MAGIC] != SEEN_MAGIC) return false;
+     if (cap == 0 || (cap & (cap - 1)) != 0) return false;
+     if (cap > SIZE_MAX / sizeof(uint64_t) - HEADER_WORDS) return false;
+     if ((uint64_t)fileSize != (HEADER_WORDS + cap) * sizeof(uint64_t)) return false;
+     return header[HEADER_COUNT] < cap;
+}
+
+/**
+ * Opens (creating if needed) the set stored at `path`.
+ *
+ * A file that is too short or whose header doesn't check out (truncated,
+ * corrupt, or not a set at all) is rebuilt as a new, empty set: forgetting
+ * what was seen only marks old articles as new again.
+ *
+ * @return 0 on success, -1 on failure with `errno` set.
+ */
+int seenSetOpen(struct SeenSet *set, const char *path) {
+     struct stat st;
+     memset(set, 0, sizeof(*set));
+     set->fd = -1;
+     snprintf(set->path, sizeof(set->path), "%s", path);
+
+     int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+     if (fd < 0) return -1;
+     if (fstat(fd, &st) != 0) {
+          close(fd);
+          return -1;
+     }
+
+     uint64_t header[HEADER_WORDS];
+     bool valid = (size_t)st.st_size >= sizeof(header) &&
+                  pread(fd, header, sizeof(header), 0) == sizeof(header) &&
+                  validHeader(header, st.st_size);
+
+     int rc;
+     if (valid) {
+          rc = mapFile(set, fd, header[HEADER_CAPACITY], false);
+     } else {
+          /* Emptied first so no stale slots survive under the fresh header */
+          rc = ftruncate(fd, 0) == 0 ? mapFile(set, fd, INITIAL_CAPACITY, true) : -1;
+     }
+     if (rc != 0) {
+          close(fd);
+          return -1;
+     }
+     return 0;
+}
+
+void seenSetClose(struct SeenSet *set) {
+     if (set->map) munmap(set->map, set->mapSize);
+     if (set->fd >= 0) close(set->fd);
+     set->map = NULL;
+     set->fd = -1;
+}
+
+/* Slot holding `key`, or the empty slot where it would go */
+static uint64_t *probe(const struct SeenSet *set, uint64_t key) {
+     uint64_t mask = capacity(set) - 1;
+     uint64_t *table = slots(set);
+     for (uint64_t i = key & mask;; i = (i + 1) & mask) {
+          if (table[i] == key || table[i] == 0) return &table[i];
+     }
+}
+
+bool seenSetContains(const struct SeenSet *set, uint64_t hash) {
+     return set->map && *probe(set, slotKey(hash)) != 0;
+}
+
+/* Rebuilds the table at twice the capacity in a new file swapped in by rename */
+static int grow(struct SeenSet *set) {
+     char tmpPath[sizeof(set->path) + 8];
+     struct SeenSet bigger;
+     uint64_t cap = capacity(set);
+
+     snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", set->path);
+     int fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+     if (fd < 0) return -1;
+     if (mapFile(&bigger, fd, cap * 2, true) != 0) {
+          close(fd);
+          unlink(tmpPath);
+          return -1;
+     }
+
+     for (uint64_t i = 0; i < cap; ++i) {
+          uint64_t key = slots(set)[i];
+          if (key) *probe(&bigger, key) = key;
+     }
+     bigger.map[HEADER_COUNT] = set->map[HEADER_COUNT];
+
+     if (rename(tmpPath, set->path) != 0) {
+          seenSetClose(&bigger);
+          unlink(tmpPath);
+          return -1;
+     }
+     snprintf(bigger.path, sizeof(bigger.path), "%s", set->path);
+     seenSetClose(set);
+     *set = bigger;
+     return 0;
+}
+
+/**
+ * Adds a hash to the set; adding one already present is a no-op.
+ *
+ * The table is kept at most 70% full so probe sequences stay short.
+ */
+int seenSetAdd(struct SeenSet *set, uint64_t hash) {
+     if (!set->map) return -1;
+
+     uint64_t key = slotKey(hash);
+     uint64_t *slot = probe(set, key);
+     if (*slot) return 0;
+
+     if ((set->map[HEADER_COUNT] + 1) * 10 > capacity(set) * 7) {
+          if (grow(set) != 0) return -1;
+          slot = probe(set, key);
+     }
+     *slot = key;
+     set->map[HEADER_COUNT]++;
+     return 0;
+}
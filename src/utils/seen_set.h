@@ -0,0 +1,26 @@
+#ifndef SEEN_SET_H
+#define SEEN_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Persistent set of 64-bit hashes: an open-addressed table in a file that is
+ * memory-mapped on open, so startup costs one mmap however many hashes the
+ * set holds, and lookups touch a page or two.
+ */
+struct SeenSet {
+     int fd;
+     char path[512];
+     /* Mapping of the whole file: a header followed by `capacity` slots */
+     uint64_t *map;
+     size_t mapSize;
+};
+
+int seenSetOpen(struct SeenSet *set, const char *path);
+void seenSetClose(struct SeenSet *set);
+bool seenSetContains(const struct SeenSet *set, uint64_t hash);
+int seenSetAdd(struct SeenSet *set, uint64_t hash);
+
+#endif  // SEEN_SET_H
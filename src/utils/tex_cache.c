@@ -0,0 +1,158 @@
+#include "tex_cache.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+
+/*
+ * File layout: the magic and the entry count, one record per entry, then
+ * every entry's LaTeX back to back in record order. The last digit of the
+ * magic is a format version: bumping it when the generated LaTeX changes
+ * makes old caches read as empty rather than as stale output.
+ */
+#define TEX_CACHE_MAGIC 0x3243584554424F5AULL /* "ZOBTEXC2" */
+
+struct DiskHeader {
+     uint64_t magic;
+     uint64_t count;
+};
+
+struct DiskEntry {
+     uint64_t key;
+     uint32_t length;
+     uint32_t tokens;
+     uint32_t state;
+     uint32_t reserved;
+};
+
+struct TexCacheKey {
+     uint64_t key;
+     size_t index;
+};
+
+static int compareKeys(const void *a, const void *b) {
+     uint64_t x = ((const struct TexCacheKey *)a)->key;
+     uint64_t y = ((const struct TexCacheKey *)b)->key;
+     return x < y ? -1 : x > y;
+}
+
+/* Indexes the mapped file; false if it isn't a whole, current cache */
+static bool loadEntries(struct TexCache *cache) {
+     const char *data = cache->file.data;
+     size_t size = cache->file.length;
+     struct DiskHeader header;
+
+     if (size < sizeof(header)) return false;
+     memcpy(&header, data, sizeof(header));
+     if (header.magic != TEX_CACHE_MAGIC ||
+         header.count > (size - sizeof(header)) / sizeof(struct DiskEntry))
+          return false;
+
+     cache->entries = calloc(header.count ? header.count : 1, sizeof(struct TexCacheEntry));
+     if (!cache->entries) return false;
+
+     size_t offset = sizeof(header) + header.count * sizeof(struct DiskEntry);
+     for (uint64_t i = 0; i < header.count; ++i) {
+          struct DiskEntry record;
+          memcpy(&record, data + sizeof(header) + i * sizeof(record), sizeof(record));
+          if (record.length > size - offset) return false;
+          cache->entries[i] = (struct TexCacheEntry){record.key, data + offset, record.length,
+                                                     record.tokens, record.state};
+          offset += record.length;
+     }
+     cache->count = header.count;
+     return true;
+}
+
+/**
+ * Reads the cache at `path`. A missing, truncated or outdated file just
+ * leaves the cache empty: every block is then converted afresh.
+ */
+void texCacheOpen(struct TexCache *cache, const char *path) {
+     memset(cache, 0, sizeof(*cache));
+     if (inputFileOpen(&cache->file, path) != 0) return;
+     if (!loadEntries(cache)) {
+          texCacheClose(cache);
+          memset(cache, 0, sizeof(*cache));
+     }
+}
+
+void texCacheClose(struct TexCache *cache) {
+     if (cache->file.data) inputFileClose(&cache->file);
+     free(cache->entries);
+     free(cache->sorted);
+     cache->entries = NULL;
+     cache->sorted = NULL;
+     cache->count = 0;
+}
+
+/**
+ * Looks up the block with hash `key`.
+ *
+ * Between edits most blocks come back in the order they were saved, so the
+ * entry after the previous hit is tried before searching the sorted keys.
+ */
+const struct TexCacheEntry *texCacheFind(struct TexCache *cache, uint64_t key) {
+     if (cache->next < cache->count && cache->entries[cache->next].key == key) {
+          return &cache->entries[cache->next++];
+     }
+     if (cache->count == 0) return NULL;
+
+     if (!cache->sorted) {
+          cache->sorted = malloc(cache->count * sizeof(struct TexCacheKey));
+          if (!cache->sorted) return NULL;
+          for (size_t i = 0; i < cache->count; ++i) {
+               cache->sorted[i] = (struct TexCacheKey){cache->entries[i].key, i};
+          }
+          qsort(cache->sorted, cache->count, sizeof(struct TexCacheKey), compareKeys);
+     }
+
+     struct TexCacheKey probe = {key, 0};
+     const struct TexCacheKey *found =
+         bsearch(&probe, cache->sorted, cache->count, sizeof(probe), compareKeys);
+     if (!found) return NULL;
+     cache->next = found->index + 1;
+     return &cache->entries[found->index];
+}
+
+/**
+ * Replaces the cache at `path` with `entries`, written to a temporary file
+ * and renamed over it, so readers never see half a cache.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int texCacheSave(const char *path, const struct TexCacheEntry *entries, size_t count) {
+     char tmpPath[4096];
+     struct OutBuf out;
+     struct DiskHeader header = {TEX_CACHE_MAGIC, count};
+
+     if (snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path) >= (int)sizeof(tmpPath)) return -1;
+     int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+     if (fd < 0) return -1;
+     if (!outBufInit(&out, fd, 64 * 1024)) {
+          close(fd);
+          unlink(tmpPath);
+          return -1;
+     }
+
+     outBufWrite(&out, (const char *)&header, sizeof(header));
+     for (size_t i = 0; i < count; ++i) {
+          struct DiskEntry record = {entries[i].key, entries[i].length, entries[i].tokens,
+                                     entries[i].state, 0};
+          outBufWrite(&out, (const char *)&record, sizeof(record));
+     }
+     for (size_t i = 0; i < count; ++i) outBufWrite(&out, entries[i].latex, entries[i].length);
+
+     bool ok = outBufFlush(&out);
+     outBufFree(&out);
+     if (close(fd) != 0) ok = false;
+     if (!ok || rename(tmpPath, path) != 0) {
+          unlink(tmpPath);
+          return -1;
+     }
+     return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef TEX_CACHE_H
+#define TEX_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "input_file.h"
+
+/* The generated LaTeX of one block of a document, keyed by a hash of its source */
+struct TexCacheEntry {
+     uint64_t key;
+     const char *latex;
+     uint32_t length;
+     /* Tokens in the block, and the converter state it leaves behind */
+     uint32_t tokens;
+     uint32_t state;
+};
+
+/**
+ * Blocks saved by the previous conversion of a document, read from its
+ * sidecar file. Entries point into the mapped file, so they stay valid until
+ * texCacheClose() even if the file is replaced meanwhile.
+ */
+struct TexCache {
+     struct InputFile file;
+     /* In document order, as saved */
+     struct TexCacheEntry *entries;
+     size_t count;
+     /* Entry after the last one found: where an unedited stretch continues */
+     size_t next;
+     /* Keys sorted for lookups out of order, built on the first one */
+     struct TexCacheKey *sorted;
+};
+
+void texCacheOpen(struct TexCache *cache, const char *path);
+void texCacheClose(struct TexCache *cache);
+const struct TexCacheEntry *texCacheFind(struct TexCache *cache, uint64_t key);
+int texCacheSave(const char *path, const struct TexCacheEntry *entries, size_t count);
+
+#endif  // TEX_CACHE_H
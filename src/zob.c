@@ -8,7 +8,7 @@
 #include "zob_fmt.h"
 
 /* Prototypes */
-void runRssProgram();
+void runRssProgram(int argc, char *argv[]);
 void runTodoProgram();
 void runTexProgram(int argc, char *argv[]); 
 void runFmtProgram(int argc, char *argv[]); 
@@ -26,7 +26,7 @@ void displayZenMenu() {
 int main(int argc, char *argv[]) {
      if (argc > 1) {
           if (strcmp(argv[1], "rss") == 0) {
-               runRssProgram();
+               runRssProgram(argc, argv);
                return 0;
           } else if (strcmp(argv[1], "todo") == 0) {
                runTodoProgram();
@@ -56,7 +56,7 @@ int main(int argc, char *argv[]) {
                          runTodoProgram();
                          break;
                     case 2:
-                         runRssProgram();
+                         runRssProgram(0, NULL);
                          break;
                     case 3:
                          runTexProgram(0, NULL);
@@ -79,7 +79,7 @@ int main(int argc, char *argv[]) {
 
 void runTodoProgram() { runTodo(); }
 
-void runRssProgram() { runRss(); }
+void runRssProgram(int argc, char *argv[]) { runRss(argc, argv); }
 
 void runTexProgram(int argc, char *argv[]) {
     runTex(argc, argv);
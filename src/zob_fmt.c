@@ -1,49 +1,842 @@
 #include "zob_fmt.h"
 
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <spawn.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "config.h"
+#include "utils/fmt_cache.h"
+#include "utils/hash.h"
+#include "utils/input_file.h"
 
+extern char **environ;
+
+/* Lines first to last (from 1, inclusive) of a file */
+typedef struct {
+     unsigned first;
+     unsigned last;
+} FmtRange;
+
+/* A file to format, and the linter its extension maps to */
+typedef struct {
+     char *path;
+     const struct Linter *linter;
+     /* Canonical path (realpath()), which the file's stamp is saved under */
+     char *key;
+     struct FmtStamp stamp;
+     /* Left alone as unchanged since its last format */
+     bool skip;
+     /* Stamp to be saved once the run is over */
+     bool save;
+     /* With --changed, the lines to format: the rest of the file is left alone */
+     FmtRange *ranges;
+     size_t rangeCount;
+} FmtJob;
+
+typedef struct {
+     FmtJob *jobs;
+     size_t count;
+     size_t capacity;
+     /* Inputs that could not be queued, plus files whose linter failed */
+     int failed;
+     size_t unchanged;
+     /* Working directory, which paths under it are shown relative to */
+     char cwd[PATH_MAX];
+} FmtBatch;
+
+/* A linter run that has been started and not yet reaped */
+typedef struct {
+     pid_t pid;
+     size_t task;
+} FmtChild;
+
+static const struct Linter *findLinter(const char *path) {
+     const char *slash = strrchr(path, '/');
+     const char *extension = strrchr(slash ? slash + 1 : path, '.');
+     if (!extension) return NULL;
+
+     for (size_t i = 0; i < sizeof(LINTER_MAPPING) / sizeof(LINTER_MAPPING[0]); ++i) {
+          if (strcmp(extension + 1, LINTER_MAPPING[i].extension) == 0) return &LINTER_MAPPING[i];
+     }
+     return NULL;
+}
+
+/**
+ * hash64() of the command line `linter` is run with, bar the files: a stamp
+ * saved under another command line doesn't vouch for the file.
+ */
+static uint64_t linterHash(const struct Linter *linter) {
+     uint64_t hash = 0;
+     for (size_t i = 0; i < LINTER_MAX_ARGS && linter->argv[i]; ++i)
+          hash = hash64(linter->argv[i], strlen(linter->argv[i]) + 1, hash);
+     return hash;
+}
+
+static void setStamp(struct FmtStamp *stamp, const struct stat *st) {
+     stamp->mtime = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+     stamp->size = st->st_size;
+     stamp->inode = st->st_ino;
+}
+
+/* Stamps the file as it is now; false if it can't be read */
+static bool stampFile(const char *path, struct FmtStamp *stamp) {
+     struct stat st;
+     struct InputFile input;
+     if (stat(path, &st) != 0 || inputFileOpen(&input, path) != 0) return false;
+     setStamp(stamp, &st);
+     stamp->hash = hash64(input.data, input.length, 0);
+     inputFileClose(&input);
+     return true;
+}
+
+/* Queues `path`, whose stat `st` was already taken on the way here */
+static bool addJob(FmtBatch *batch, const char *path, const struct stat *st,
+                   const struct Linter *linter) {
+     if (batch->count == batch->capacity) {
+          size_t capacity = batch->capacity ? 2 * batch->capacity : 64;
+          FmtJob *grown = realloc(batch->jobs, capacity * sizeof(FmtJob));
+          if (!grown) return false;
+          batch->jobs = grown;
+          batch->capacity = capacity;
+     }
+
+     /* One key per file, however it was reached: relative, through '..' or a symlink */
+     FmtJob job = {.path = strdup(path), .linter = linter, .key = realpath(path, NULL)};
+     if (!job.path || !job.key) {
+          free(job.path);
+          free(job.key);
+          return false;
+     }
+     setStamp(&job.stamp, st);
+     job.stamp.linter = linterHash(linter);
+     batch->jobs[batch->count++] = job;
+     return true;
+}
+
+/**
+ * Queues every file under `dir` that some linter handles. Hidden entries
+ * and symlinked directories are skipped.
+ */
+static void addDirectory(FmtBatch *batch, const char *dir) {
+     DIR *handle = opendir(dir);
+     if (!handle) {
+          fprintf(stderr, "「Z O B」- Failed to open directory: %s: %s\n", dir, strerror(errno));
+          batch->failed++;
+          return;
+     }
+
+     struct dirent *entry;
+     while ((entry = readdir(handle))) {
+          char path[PATH_MAX];
+          struct stat st;
+          const struct Linter *linter;
+          if (entry->d_name[0] == '.') continue;
+
+          snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+          if (lstat(path, &st) != 0) continue;
+          /* Links to files are followed, links to directories not: one to an ancestor loops */
+          if (S_ISLNK(st.st_mode) && (stat(path, &st) != 0 || S_ISDIR(st.st_mode))) continue;
+          if (S_ISDIR(st.st_mode)) {
+               addDirectory(batch, path);
+          } else if (S_ISREG(st.st_mode) && (linter = findLinter(path))) {
+               if (!addJob(batch, path, &st, linter)) batch->failed++;
+          }
+     }
+     closedir(handle);
+}
+
+/* Queues a path given on the command line: a directory, or a file that must have a linter */
+static void addPath(FmtBatch *batch, const char *path) {
+     struct stat st;
+     if (stat(path, &st) != 0) {
+          fprintf(stderr, "「Z O B」- %s: %s\n", path, strerror(errno));
+          batch->failed++;
+          return;
+     }
+     if (S_ISDIR(st.st_mode)) {
+          addDirectory(batch, path);
+          return;
+     }
+
+     const struct Linter *linter = findLinter(path);
+     if (!linter) {
+          fprintf(stderr, "「Z O B」- No linter configuration found for: %s\n", path);
+          batch->failed++;
+     } else if (!addJob(batch, path, &st, linter)) {
+          batch->failed++;
+     }
+}
+
+/**
+ * Whether `job` is as its last format left it, by the same linter command
+ * line. A file whose stat tuple matches is taken as unchanged without being
+ * opened; one that was touched but whose contents hash the same is too, and
+ * its new stat is saved.
+ */
+static bool unchanged(struct FmtCache *cache, FmtJob *job) {
+     struct FmtStamp saved;
+     if (!fmtCacheFind(cache, job->key, &saved) || saved.size != job->stamp.size ||
+         saved.linter != job->stamp.linter)
+          return false;
+     if (saved.mtime == job->stamp.mtime && saved.inode == job->stamp.inode) return true;
+
+     if (!stampFile(job->path, &job->stamp) || job->stamp.hash != saved.hash) return false;
+     job->save = true;
+     return true;
+}
+
+/* A linter run over `count` files, order[first] onwards */
+typedef struct {
+     size_t first;
+     size_t count;
+} FmtTask;
+
+/* Every linter run of a zob fmt, in the order they are started */
+typedef struct {
+     FmtBatch *batch;
+     /* Indexes of the files to lint, grouped by linter */
+     size_t *order;
+     FmtTask *tasks;
+     size_t count;
+     size_t capacity;
+} FmtPlan;
+
+static bool addTask(FmtPlan *plan, size_t first, size_t count) {
+     if (plan->count == plan->capacity) {
+          size_t capacity = plan->capacity ? 2 * plan->capacity : 64;
+          FmtTask *grown = realloc(plan->tasks, capacity * sizeof(FmtTask));
+          if (!grown) return false;
+          plan->tasks = grown;
+          plan->capacity = capacity;
+     }
+     plan->tasks[plan->count++] = (FmtTask){first, count};
+     return true;
+}
+
+/* Whether `job` is linted on its own, as its line ranges apply to it alone */
+static bool runsAlone(const FmtJob *job) { return job->rangeCount > 0 && job->linter->lines; }
+
+static const FmtJob *taskJob(const FmtPlan *plan, const FmtTask *task, size_t i) {
+     return &plan->batch->jobs[plan->order[task->first + i]];
+}
+
+/* Room left for file arguments once the environment and a margin are accounted for */
+static size_t argumentBudget(void) {
+     long max = sysconf(_SC_ARG_MAX);
+     size_t used = 4096;
+     for (char **env = environ; *env; ++env) used += strlen(*env) + 1 + sizeof(char *);
+     if (max <= 0) max = 128 * 1024;
+     return (size_t)max > 2 * used ? (size_t)max - used : (size_t)max / 2;
+}
+
+/**
+ * Splits the files to lint into linter runs. A linter that takes many files
+ * gets them in batches: small enough to spread over all `jobs` workers,
+ * to stay under FMT_BATCH_MAX files, and to fit the argument list in
+ * ARG_MAX. Others get one run per file, as does a file limited to some of
+ * its lines.
+ */
+static bool planTasks(FmtPlan *plan, size_t jobs) {
+     FmtBatch *batch = plan->batch;
+     size_t budget = argumentBudget(), files = 0;
+
+     plan->order = malloc((batch->count ? batch->count : 1) * sizeof(size_t));
+     if (!plan->order) return false;
+
+     for (size_t l = 0; l < sizeof(LINTER_MAPPING) / sizeof(LINTER_MAPPING[0]); ++l) {
+          const struct Linter *linter = &LINTER_MAPPING[l];
+          size_t first = files;
+          for (size_t i = 0; i < batch->count; ++i) {
+               const FmtJob *job = &batch->jobs[i];
+               if (!job->skip && job->linter == linter) plan->order[files++] = i;
+          }
+
+          size_t perRun = linter->batch ? (files - first + jobs - 1) / jobs : 1;
+          if (perRun > FMT_BATCH_MAX) perRun = FMT_BATCH_MAX;
+          for (size_t start = first; start < files;) {
+               size_t count = 0, bytes = 0;
+               while (start + count < files && (count == 0 || count < perRun)) {
+                    const FmtJob *job = &batch->jobs[plan->order[start + count]];
+                    bytes += strlen(job->path) + 1 + sizeof(char *);
+                    if (count > 0 && (bytes > budget || runsAlone(job))) break;
+                    count++;
+                    if (runsAlone(job)) break;
+               }
+               if (!addTask(plan, start, count)) return false;
+               start += count;
+          }
+     }
+     return true;
+}
+
+/* Starts the linter on the files of `task` without a shell in between; returns its pid, or -1 */
+static pid_t spawnLinter(const FmtPlan *plan, const FmtTask *task) {
+     const FmtJob *first = taskJob(plan, task, 0);
+     const struct Linter *linter = first->linter;
+     size_t ranges = runsAlone(first) ? first->rangeCount : 0;
+     const char **argv = malloc((LINTER_MAX_ARGS + ranges + task->count + 1) * sizeof(char *));
+     char(*rangeArgs)[32] = malloc((ranges ? ranges : 1) * sizeof(*rangeArgs));
+     size_t argc = 0;
+     pid_t pid;
+
+     if (!argv || !rangeArgs) {
+          free(argv);
+          free(rangeArgs);
+          return -1;
+     }
+     while (argc < LINTER_MAX_ARGS && linter->argv[argc]) {
+          argv[argc] = linter->argv[argc];
+          argc++;
+     }
+     for (size_t i = 0; i < ranges; ++i) {
+          snprintf(rangeArgs[i], sizeof(rangeArgs[i]), linter->lines, first->ranges[i].first,
+                   first->ranges[i].last);
+          argv[argc++] = rangeArgs[i];
+     }
+     for (size_t i = 0; i < task->count; ++i) argv[argc++] = taskJob(plan, task, i)->path;
+     argv[argc] = NULL;
+
+     int error = posix_spawnp(&pid, argv[0], NULL, NULL, (char *const *)argv, environ);
+     free(argv);
+     free(rangeArgs);
+     if (error != 0) {
+          for (size_t i = 0; i < task->count; ++i) {
+               fprintf(stderr, "「Z O B」- %s: failed to run %s: %s\n",
+                       taskJob(plan, task, i)->path, linter->argv[0], strerror(error));
+          }
+          return -1;
+     }
+     return pid;
+}
+
+static void reportFailure(const FmtJob *job, int status) {
+     if (WIFEXITED(status)) {
+          fprintf(stderr, "「Z O B」- %s: %s exited with status %d\n", job->path,
+                  job->linter->argv[0], WEXITSTATUS(status));
+     } else {
+          fprintf(stderr, "「Z O B」- %s: %s was killed by signal %d\n", job->path,
+                  job->linter->argv[0], WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+     }
+}
+
+/**
+ * Accounts for a linter run that exited with `status`. When a batch fails,
+ * its files are queued again one run each, so the failure is pinned on the
+ * files that actually caused it. Files formatted whole are stamped, those
+ * limited to some lines are not.
+ *
+ * @return The number of files formatted successfully.
+ */
+static size_t finishTask(FmtPlan *plan, size_t t, int status) {
+     FmtTask task = plan->tasks[t];
+     FmtBatch *batch = plan->batch;
+
+     if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          if (task.count == 1) {
+               reportFailure(taskJob(plan, &task, 0), status);
+               batch->failed++;
+               return 0;
+          }
+          for (size_t i = 0; i < task.count; ++i) {
+               if (!addTask(plan, task.first + i, 1)) batch->failed++;
+          }
+          return 0;
+     }
+
+     for (size_t i = 0; i < task.count; ++i) {
+          FmtJob *job = &batch->jobs[plan->order[task.first + i]];
+          printf("「Z O B」- ✨ %s ✨ has been cleansed.\n", job->path);
+          /* Only some lines were formatted, so the rest can't be vouched for */
+          if (job->rangeCount == 0) job->save = stampFile(job->path, &job->stamp);
+     }
+     return task.count;
+}
+
+/**
+ * Formats every queued file not marked to skip, keeping up to `jobs` linter
+ * runs going at once: as soon as one exits, the next takes its place.
+ *
+ * @return The number of files formatted successfully.
+ */
+static size_t runLinters(FmtBatch *batch, size_t jobs) {
+     FmtPlan plan = {.batch = batch};
+     FmtChild *children = calloc(jobs, sizeof(FmtChild));
+     size_t next = 0, running = 0, cleansed = 0;
+
+     if (!children || !planTasks(&plan, jobs)) {
+          fprintf(stderr, "「Z O B」- Out of memory.\n");
+          batch->failed += batch->count - batch->unchanged;
+          free(children);
+          free(plan.order);
+          free(plan.tasks);
+          return 0;
+     }
+
+     /* Output from the linters and from here is interleaved; flush before each fork */
+     fflush(stdout);
+     while (next < plan.count || running > 0) {
+          while (running < jobs && next < plan.count) {
+               pid_t pid = spawnLinter(&plan, &plan.tasks[next]);
+               if (pid < 0) {
+                    batch->failed += plan.tasks[next].count;
+               } else {
+                    children[running++] = (FmtChild){pid, next};
+               }
+               next++;
+          }
+          if (running == 0) break;
+
+          int status;
+          pid_t pid = waitpid(-1, &status, 0);
+          if (pid < 0) {
+               if (errno == EINTR) continue;
+               fprintf(stderr, "「Z O B」- waitpid: %s\n", strerror(errno));
+               for (size_t i = 0; i < running; ++i) {
+                    batch->failed += plan.tasks[children[i].task].count;
+               }
+               break;
+          }
+          for (size_t i = 0; i < running; ++i) {
+               if (children[i].pid != pid) continue;
+               cleansed += finishTask(&plan, children[i].task, status);
+               children[i] = children[--running];
+               fflush(stdout);
+               break;
+          }
+     }
+
+     free(children);
+     free(plan.order);
+     free(plan.tasks);
+     return cleansed;
+}
+
+static size_t fmtJobs(void) {
+     long cores = FMT_JOBS > 0 ? FMT_JOBS : sysconf(_SC_NPROCESSORS_ONLN);
+     return cores > 0 ? (size_t)cores : 1;
+}
+
+/* Saves the stamps of the files this run formatted or found unchanged */
+static void saveStamps(struct FmtCache *cache, const FmtBatch *batch) {
+     struct FmtRecord *records = calloc(batch->count ? batch->count : 1, sizeof(*records));
+     size_t count = 0;
+     if (!records) return;
+
+     for (size_t i = 0; i < batch->count; ++i) {
+          if (batch->jobs[i].save)
+               records[count++] = (struct FmtRecord){batch->jobs[i].key, batch->jobs[i].stamp};
+     }
+     /* Not saving only costs the next run some linting */
+     fmtCacheSave(cache, records, count);
+     free(records);
+}
+
+/**
+ * Lints the queued files that changed since their last format and saves
+ * their new stamps.
+ *
+ * @return The number of files formatted successfully.
+ */
+static size_t lintBatch(FmtBatch *batch, struct FmtCache *cache, size_t jobs, bool force) {
+     for (size_t i = 0; !force && i < batch->count; ++i) {
+          if ((batch->jobs[i].skip = unchanged(cache, &batch->jobs[i]))) batch->unchanged++;
+     }
+
+     size_t cleansed = batch->count > batch->unchanged ? runLinters(batch, jobs) : 0;
+     saveStamps(cache, batch);
+     return cleansed;
+}
+
+static void freeBatch(FmtBatch *batch) {
+     for (size_t i = 0; i < batch->count; ++i) {
+          free(batch->jobs[i].path);
+          free(batch->jobs[i].key);
+          free(batch->jobs[i].ranges);
+     }
+     free(batch->jobs);
+}
+
+/* Directories under watch, indexed by their watch descriptor */
+typedef struct {
+     int fd;
+     char **dirs;
+     size_t capacity;
+} FmtWatch;
+
+/* Files saved since the last round of linting, each once */
+typedef struct {
+     char **paths;
+     size_t count;
+     size_t capacity;
+} FmtPending;
+
+/* Watches `dir` and every directory below it, bar hidden and symlinked ones */
+static void watchDirectory(FmtWatch *watch, const char *dir) {
+     int wd = inotify_add_watch(watch->fd, dir,
+                                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+     if (wd < 0) {
+          fprintf(stderr, "「Z O B」- Failed to watch directory: %s: %s\n", dir, strerror(errno));
+          return;
+     }
+     if ((size_t)wd >= watch->capacity) {
+          size_t capacity = watch->capacity ? 2 * watch->capacity : 64;
+          while (capacity <= (size_t)wd) capacity *= 2;
+          char **grown = realloc(watch->dirs, capacity * sizeof(char *));
+          if (!grown) return;
+          memset(grown + watch->capacity, 0, (capacity - watch->capacity) * sizeof(char *));
+          watch->dirs = grown;
+          watch->capacity = capacity;
+     }
+     free(watch->dirs[wd]);
+     watch->dirs[wd] = strdup(dir);
+
+     DIR *handle = opendir(dir);
+     if (!handle) return;
+     struct dirent *entry;
+     while ((entry = readdir(handle))) {
+          char path[PATH_MAX];
+          struct stat st;
+          if (entry->d_name[0] == '.') continue;
+          snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+          if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) watchDirectory(watch, path);
+     }
+     closedir(handle);
+}
+
+static void addPending(FmtPending *pending, const char *path) {
+     for (size_t i = 0; i < pending->count; ++i) {
+          if (strcmp(pending->paths[i], path) == 0) return;
+     }
+     if (pending->count == pending->capacity) {
+          size_t capacity = pending->capacity ? 2 * pending->capacity : 16;
+          char **grown = realloc(pending->paths, capacity * sizeof(char *));
+          if (!grown) return;
+          pending->paths = grown;
+          pending->capacity = capacity;
+     }
+     char *copy = strdup(path);
+     if (copy) pending->paths[pending->count++] = copy;
+}
+
+/* Reads the events waiting on the watch; false once it can no longer be read */
+static bool readEvents(FmtWatch *watch, FmtPending *pending) {
+     char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+     ssize_t got = read(watch->fd, events, sizeof(events));
+     if (got < 0 && errno == EINTR) return true;
+     if (got <= 0) return false;
+
+     for (char *ptr = events; ptr < events + got;) {
+          struct inotify_event *event = (struct inotify_event *)ptr;
+          ptr += sizeof(*event) + event->len;
+
+          if (event->mask & IN_Q_OVERFLOW) {
+               fprintf(stderr, "「Z O B」- Too many changes at once; some saves were missed.\n");
+               continue;
+          }
+          if ((size_t)event->wd >= watch->capacity || !watch->dirs[event->wd]) continue;
+          if (event->mask & IN_IGNORED) {
+               free(watch->dirs[event->wd]);
+               watch->dirs[event->wd] = NULL;
+               continue;
+          }
+          if (event->len == 0 || event->name[0] == '.') continue;
+
+          char path[PATH_MAX];
+          snprintf(path, sizeof(path), "%s/%s", watch->dirs[event->wd], event->name);
+          if (event->mask & IN_ISDIR) {
+               if (event->mask & (IN_CREATE | IN_MOVED_TO)) watchDirectory(watch, path);
+          } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && findLinter(path)) {
+               addPending(pending, path);
+          }
+     }
+     return true;
+}
+
+/* Lints the pending files that still exist, then forgets them */
+static void lintPending(FmtPending *pending, struct FmtCache *cache, size_t jobs,
+                        const char *cwd) {
+     FmtBatch batch = {0};
+     struct stat st;
+
+     snprintf(batch.cwd, sizeof(batch.cwd), "%s", cwd);
+     for (size_t i = 0; i < pending->count; ++i) {
+          if (stat(pending->paths[i], &st) == 0 && S_ISREG(st.st_mode))
+               addPath(&batch, pending->paths[i]);
+          free(pending->paths[i]);
+     }
+     pending->count = 0;
+
+     lintBatch(&batch, cache, jobs, false);
+     fflush(stdout);
+     freeBatch(&batch);
+}
+
+/**
+ * Lints every file saved under `dirs` until killed. A burst of writes to a
+ * file, as editors make on save, is linted once FMT_WATCH_DEBOUNCE_MS have
+ * passed without another. The linter's own rewrite of a file comes back as
+ * an event too, but by then the file carries the stamp saved after linting
+ * it, so it is recognised as unchanged rather than linted again.
+ */
+static void watchFmt(char **dirs, int count, struct FmtCache *cache, size_t jobs,
+                     const char *cwd) {
+     FmtWatch watch = {.fd = inotify_init1(IN_CLOEXEC)};
+     FmtPending pending = {0};
+
+     if (watch.fd < 0) {
+          fprintf(stderr, "「Z O B」- inotify: %s\n", strerror(errno));
+          return;
+     }
+     for (int i = 0; i < count; ++i) watchDirectory(&watch, dirs[i]);
+     printf("「Z O B」- Watching for saves; Ctrl-C to stop.\n");
+     fflush(stdout);
+
+     while (1) {
+          struct pollfd fds = {watch.fd, POLLIN, 0};
+          /* Blocks for good while nothing is pending, so an idle watch costs nothing */
+          int ready = poll(&fds, 1, pending.count ? FMT_WATCH_DEBOUNCE_MS : -1);
+          if (ready < 0) {
+               if (errno == EINTR) continue;
+               break;
+          }
+          if (ready == 0) {
+               lintPending(&pending, cache, jobs, cwd);
+          } else if (!readEvents(&watch, &pending)) {
+               break;
+          }
+     }
+
+     for (size_t i = 0; i < watch.capacity; ++i) free(watch.dirs[i]);
+     free(watch.dirs);
+     for (size_t i = 0; i < pending.count; ++i) free(pending.paths[i]);
+     free(pending.paths);
+     close(watch.fd);
+}
+
+/**
+ * Runs `argv` with its stdout on a pipe, for the caller to read and then
+ * hand to finishReader().
+ *
+ * @return The read end, or NULL if it could not be started.
+ */
+static FILE *spawnReader(const char *const argv[], pid_t *pid) {
+     posix_spawn_file_actions_t actions;
+     int fds[2];
+     if (pipe(fds) != 0) return NULL;
+
+     posix_spawn_file_actions_init(&actions);
+     posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+     posix_spawn_file_actions_addclose(&actions, fds[0]);
+     posix_spawn_file_actions_addclose(&actions, fds[1]);
+     int error = posix_spawnp(pid, argv[0], &actions, NULL, (char *const *)argv, environ);
+     posix_spawn_file_actions_destroy(&actions);
+     close(fds[1]);
+
+     if (error != 0) {
+          fprintf(stderr, "「Z O B」- failed to run %s: %s\n", argv[0], strerror(error));
+          close(fds[0]);
+          return NULL;
+     }
+     FILE *reader = fdopen(fds[0], "r");
+     if (!reader) close(fds[0]);
+     return reader;
+}
+
+/* Closes the pipe and reaps its writer; true if it exited cleanly */
+static bool finishReader(FILE *reader, pid_t pid) {
+     int status;
+     fclose(reader);
+     while (waitpid(pid, &status, 0) < 0) {
+          if (errno != EINTR) return false;
+     }
+     return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool addRange(FmtJob *job, unsigned first, unsigned last) {
+     FmtRange *grown = realloc(job->ranges, (job->rangeCount + 1) * sizeof(FmtRange));
+     if (!grown) return false;
+     job->ranges = grown;
+     job->ranges[job->rangeCount++] = (FmtRange){first, last};
+     return true;
+}
+
+/**
+ * Queues the file at `top`/`name` changed in the diff, shown relative to the
+ * working directory when it is below it.
+ *
+ * @return The queued job, or NULL if there is no linter for it or it is gone.
+ */
+static FmtJob *addChanged(FmtBatch *batch, const char *top, const char *name) {
+     char path[PATH_MAX];
+     struct stat st;
+     const struct Linter *linter = findLinter(name);
+     if (!linter) return NULL;
+
+     snprintf(path, sizeof(path), "%s/%s", top, name);
+     if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return NULL;
+
+     size_t cwdLength = strlen(batch->cwd);
+     const char *shown = path;
+     if (strncmp(path, batch->cwd, cwdLength) == 0 && path[cwdLength] == '/')
+          shown = path + cwdLength + 1;
+     if (!addJob(batch, shown, &st, linter)) {
+          batch->failed++;
+          return NULL;
+     }
+     return &batch->jobs[batch->count - 1];
+}
+
+/* Drops the file last queued from the diff if it turned out to add no lines */
+static void dropUnchanged(FmtBatch *batch, FmtJob *job) {
+     if (!job || job->rangeCount > 0) return;
+     free(job->path);
+     free(job->key);
+     batch->count--;
+}
+
+/**
+ * Queues the files changed since `base` (HEAD by default, so staged and
+ * unstaged edits alike), each limited to the lines the diff adds or
+ * modifies. Files with only deletions have nothing left to format and are
+ * skipped. Everything comes from one `git diff -U0`: file names from its
+ * headers, line ranges from its hunk headers.
+ *
+ * @return false if git could not tell what changed.
+ */
+static bool addChangedFiles(FmtBatch *batch, const char *base) {
+     const char *topArgv[] = {"git", "rev-parse", "--show-toplevel", NULL};
+     char top[PATH_MAX];
+     pid_t pid;
+
+     FILE *reader = spawnReader(topArgv, &pid);
+     if (!reader) return false;
+     bool ok = fgets(top, sizeof(top), reader) != NULL;
+     if (!finishReader(reader, pid) || !ok) return false;
+     top[strcspn(top, "\n")] = '\0';
+
+     const char *diffArgv[] = {
+         "git", "-C", top, "diff", "-U0", "--no-color", "--no-ext-diff", "--no-prefix",
+         "--diff-filter=ACMR", base ? base : "HEAD", "--", NULL};
+     reader = spawnReader(diffArgv, &pid);
+     if (!reader) return false;
+
+     char *line = NULL;
+     size_t size = 0;
+     ssize_t length;
+     FmtJob *job = NULL;
+     bool inHeader = false;
+     while ((length = getline(&line, &size, reader)) > 0) {
+          if (line[length - 1] == '\n') line[--length] = '\0';
+          if (strncmp(line, "diff --git ", 11) == 0) {
+               dropUnchanged(batch, job);
+               job = NULL;
+               inHeader = true;
+          } else if (inHeader && strncmp(line, "+++ ", 4) == 0) {
+               job = addChanged(batch, top, line + 4);
+          } else if (strncmp(line, "@@ ", 3) == 0) {
+               /* @@ -a[,b] +c[,d] @@: d lines from c, one if d is left out */
+               unsigned first, count = 1;
+               const char *plus = strstr(line, " +");
+               inHeader = false;
+               if (!job || !plus || sscanf(plus + 2, "%u,%u", &first, &count) < 1) continue;
+               if (count > 0 && !addRange(job, first, first + count - 1)) batch->failed++;
+          }
+     }
+     dropUnchanged(batch, job);
+     free(line);
+     return finishReader(reader, pid);
+}
+
+/**
+ * zob fmt [-j N] [--force] <files|dirs...>
+ * zob fmt [-j N] --watch <dirs...>
+ * zob fmt [-j N] [--force] --changed [base]
+ *
+ * Runs the linter LINTER_MAPPING gives for each file's extension, directories
+ * being walked for every file that has one. Linters run as a pool of child
+ * processes, one per core unless -j or FMT_JOBS says otherwise. A file whose
+ * linter fails is reported and counted; the rest carry on.
+ *
+ * Files unchanged since zob fmt last formatted them are skipped, going by
+ * the FmtCache table in the zob database; --force lints them all the same.
+ * --watch lints files under the given directories as they are saved.
+ * --changed lints only what git diff reports as changed since `base`.
+ */
 void runFmt(int argc, char **argv) {
-     char filename[256] = {0};
+     FmtBatch batch = {0};
+     struct FmtCache cache;
+     size_t jobs = fmtJobs();
+     bool force = false, watch = false, changed = false;
+
+     if (!getcwd(batch.cwd, sizeof(batch.cwd))) {
+          fprintf(stderr, "「Z O B」- getcwd: %s\n", strerror(errno));
+          return;
+     }
 
-     if (argc < 2) {
-          system("clear || cls");
+     if (argc < 3) {
+          char filename[256] = {0};
           printf("「Z O B」- Enter the file name: ");
           if (scanf("%255s", filename) != 1) {
                fprintf(stderr, "「Z O B」- Error reading filename.\n");
                return;
           }
-     } else {
-          strncpy(filename, argv[2], sizeof(filename) - 1);
+          addPath(&batch, filename);
      }
 
-     const char *fileExtension = strrchr(filename, '.');
-     if (!fileExtension) {
-          fprintf(stderr, "「Z O B」- File extension not found.\n");
+     int paths = 0;
+     for (int i = 2; i < argc; ++i) {
+          if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+               long requested = strtol(argv[++i], NULL, 10);
+               if (requested > 0) jobs = (size_t)requested;
+          } else if (strcmp(argv[i], "--force") == 0) {
+               force = true;
+          } else if (strcmp(argv[i], "--watch") == 0) {
+               watch = true;
+          } else if (strcmp(argv[i], "--changed") == 0) {
+               changed = true;
+          } else {
+               /* Paths are moved to the front of argv, in order */
+               argv[2 + paths++] = argv[i];
+          }
+     }
+
+     /* Without the database every file is simply linted */
+     fmtCacheOpen(&cache);
+     if (watch) {
+          if (paths == 0) {
+               fprintf(stderr, "「Z O B」- --watch needs directories to watch.\n");
+          } else {
+               watchFmt(argv + 2, paths, &cache, jobs, batch.cwd);
+          }
+          fmtCacheClose(&cache);
           return;
      }
 
-     bool commandExecuted = false;
-     for (int i = 0; i < sizeof(LINTER_MAPPING) / sizeof(LINTER_MAPPING[0]); ++i) {
-          if (strcmp(fileExtension + 1, LINTER_MAPPING[i][0]) == 0) {
-               system("clear || cls");
-               char command[LINTER_CMD_MAX_SIZE];
-               snprintf(command, sizeof(command), LINTER_MAPPING[i][1], filename);
-               int status = system(command);
-               if (status != -1) {
-                    printf("「Z O B」- ✨ %s ✨ has been cleansed.\n", filename);
-                    commandExecuted = true;
-                    break;
-               }
+     if (changed) {
+          if (!addChangedFiles(&batch, paths > 0 ? argv[2] : NULL)) {
+               fprintf(stderr, "「Z O B」- git diff failed: is this a git checkout?\n");
+               batch.failed++;
           }
+     } else {
+          for (int i = 0; i < paths; ++i) addPath(&batch, argv[2 + i]);
      }
+     size_t cleansed = lintBatch(&batch, &cache, jobs, force);
+     fmtCacheClose(&cache);
 
-     if (!commandExecuted) {
-          fprintf(stderr, "「Z O B」- No linter configuration found for the given file type.\n");
+     if (batch.count + batch.failed > 1 || batch.unchanged > 0) {
+          printf("「Z O B」- Cleansed %zu of %zu files", cleansed, batch.count - batch.unchanged);
+          if (batch.unchanged) printf("; %zu unchanged", batch.unchanged);
+          printf(batch.failed ? "; %d failed\n" : "\n", batch.failed);
      }
+     freeBatch(&batch);
 }
@@ -1,42 +1,156 @@
-#include <ctype.h>
 #include <curl/curl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "config.h"
+#include "utils/rss_store.h"
+#include "utils/seen_set.h"
 #include "zob_rss.h"
 
-struct MemoryStruct {
-     char *memory;
-     size_t size;
+/**
+ * Long-lived fetch state for the lifetime of runRss().
+ *
+ * The share object holds the DNS cache, TLS sessions and connection pool, so
+ * re-opening a feed (or fetching several on the same origin) skips the
+ * resolve and handshakes. Single-feed fetches also reuse one easy handle.
+ * Parsed feeds are cached in the zob database for conditional GETs and
+ * offline reads; `db` is NULL when the database cannot be opened, in which
+ * case the compiled-in publications stand in for the feed registry.
+ *
+ * `seen` remembers every item ever rendered; with `newOnly` those are left
+ * out. Its map is NULL when the file cannot be opened, which shows everything.
+ */
+struct FetchContext {
+     CURLSH *share;
+     CURL *curl;
+     sqlite3 *db;
+     bool offline;
+     /* Summarize each fetch in one line instead of rendering its items */
+     bool quiet;
+     bool newOnly;
+     struct SeenSet seen;
+     struct RssFeed *feed;
+     struct Subscription *subs;
+     int numSubs;
+};
+
+/**
+ * Per-transfer state, shared by single and concurrent fetches.
+ *
+ * The body is parsed as curl delivers it and never buffered. Items are
+ * collected into `feed` for the cache and, for a `live` fetch, rendered the
+ * moment they close; concurrent fetches render on completion instead so
+ * feeds don't interleave on screen.
+ */
+struct FeedFetch {
+     struct FetchContext *ctx;
+     const char *name;
+     const char *url;
+     CURL *curl;
+     struct RssParser parser;
+     struct RssFeed *feed;
+     bool live;
+     /* Items actually rendered, which `newOnly` may make fewer than parsed */
+     int shown;
+     struct curl_slist *headers;
+     /* Body bytes after content decoding, as handed to the parser */
+     curl_off_t decodedBytes;
 };
 
 /* Prototypes */
-char *trimWhitespace(char *str);
-static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb,
-                                  struct MemoryStruct *mem);
-void parse_rss(const char *rss_content);
+static size_t WriteRssCallback(void *contents, size_t size, size_t nmemb,
+                               struct FeedFetch *fetch);
+void collectItem(const struct RssItem *item, void *userdata);
+bool renderItem(struct FetchContext *ctx, int number, const struct RssItem *item);
+int renderRss(struct FetchContext *ctx, const struct RssFeed *feed);
+void renderNothingNew(const struct FetchContext *ctx, int shown);
 size_t write_data(void *ptr, size_t size, size_t nmemb, FILE *stream);
-void httpGet(const char *url);
-void displayRssMenu();
+int fetchContextInit(struct FetchContext *ctx);
+void fetchContextCleanup(struct FetchContext *ctx);
+void fetchPrepare(struct FetchContext *ctx, CURL *curl, struct FeedFetch *fetch);
+void fetchFinish(struct FetchContext *ctx, CURL *curl, struct FeedFetch *fetch, CURLcode res);
+void renderCached(struct FetchContext *ctx, const char *url);
+void httpGet(struct FetchContext *ctx, const struct Subscription *sub);
+void httpGetAll(struct FetchContext *ctx, const struct Subscription *subs, int count);
+int runRssCommand(struct FetchContext *ctx, int argc, char **argv);
+void listFeeds(struct FetchContext *ctx);
+void refreshDueFeeds(struct FetchContext *ctx);
+void searchArticles(struct FetchContext *ctx, int argc, char **argv);
+int daemonLock(void);
+bool daemonRunning(void);
+void runRssDaemon(struct FetchContext *ctx);
+void displayRssMenu(const struct FetchContext *ctx);
 
 /* main entrypoint */
-void runRss() {
+void runRss(int argc, char **argv) {
      int choice;
+     bool all = false;
+     struct FetchContext ctx;
+
+     if (fetchContextInit(&ctx) != 0) {
+          fprintf(stderr, "Failed to initialize cURL\n");
+          return;
+     }
+
+     if (argc > 2 && argv[2][0] != '-') {
+          runRssCommand(&ctx, argc, argv);
+          fetchContextCleanup(&ctx);
+          return;
+     }
+
+     for (int i = 2; i < argc; ++i) {
+          if (strcmp(argv[i], "--all") == 0) {
+               all = true;
+          } else if (strcmp(argv[i], "--offline") == 0) {
+               ctx.offline = true;
+          } else if (strcmp(argv[i], "--new") == 0) {
+               ctx.newOnly = true;
+          } else if (strcmp(argv[i], "--daemon") == 0) {
+               runRssDaemon(&ctx);
+               fetchContextCleanup(&ctx);
+               return;
+          }
+     }
+
+     /* While the daemon keeps the database fresh, reading never touches the network */
+     if (ctx.db && daemonRunning()) ctx.offline = true;
+
+     if (all) {
+          httpGetAll(&ctx, ctx.subs, ctx.numSubs);
+          fetchContextCleanup(&ctx);
+          return;
+     }
 
      while (1) {
           system("clear || cls");
-          displayRssMenu();
+          displayRssMenu(&ctx);
           scanf("%d", &choice);
           while (getchar() != '\n')
                ;
 
-          if (choice > 0 && choice <= NUM_PUBLICATIONS) {
-               httpGet(publications[choice - 1].url);
+          if (choice > 0 && choice <= ctx.numSubs) {
+               httpGet(&ctx, &ctx.subs[choice - 1]);
                printf("\nPress ENTER to return to the menu...");
                getchar();
-          } else if (choice == NUM_PUBLICATIONS + 1) {
+          } else if (choice == ctx.numSubs + 1) {
+               system("clear || cls");
+               httpGetAll(&ctx, ctx.subs, ctx.numSubs);
+               printf("\nPress ENTER to return to the menu...");
+               getchar();
+          } else if (choice == ctx.numSubs + 2) {
+               ctx.newOnly = !ctx.newOnly;
+          } else if (choice == ctx.numSubs + 3) {
                system("clear || cls");
                printf("「Z O B」— Exiting... May your path be enlightened.\n");
                break;
@@ -46,136 +160,607 @@ void runRss() {
                    "again.\n");
           }
      }
+
+     fetchContextCleanup(&ctx);
 }
 
-void displayRssMenu() {
-     printf("\n「Z O B」— Zen RSS\n\n");
-     for (int i = 0; i < NUM_PUBLICATIONS; ++i) {
-          printf("%d. %s\n", i + 1, publications[i].name);
+/**
+ * Feed registry commands:
+ *   zob rss add <url> [name]   — subscribe to a feed
+ *   zob rss remove <id>        — unsubscribe
+ *   zob rss list               — show feeds and when each is next due
+ *   zob rss refresh            — fetch only the feeds that are due
+ *   zob rss search <query>     — full-text search of every article fetched so far
+ */
+int runRssCommand(struct FetchContext *ctx, int argc, char **argv) {
+     const char *command = argv[2];
+
+     if (!ctx->db) {
+          fprintf(stderr,
+                  "「Z O B」— The feed registry lives in the zob database, which is "
+                  "unreachable.\n");
+          return -1;
      }
-     printf("%d. Exit\n\n", NUM_PUBLICATIONS + 1);
-     printf("Select the source or exit: ");
+
+     if (strcmp(command, "add") == 0 && argc > 3) {
+          const char *name = argc > 4 ? argv[4] : argv[3];
+          if (rssFeedAdd(ctx->db, name, argv[3]) != SQLITE_OK) {
+               fprintf(stderr, "「Z O B」— Could not add feed: %s\n", sqlite3_errmsg(ctx->db));
+               return -1;
+          }
+          printf("「Z O B」— \"%s\" joins the stream.\n", name);
+     } else if (strcmp(command, "remove") == 0 && argc > 3) {
+          int rc = rssFeedRemove(ctx->db, atoi(argv[3]));
+          if (rc == SQLITE_NOTFOUND) {
+               printf("「Z O B」— No feed with such ID was found.\n");
+               return -1;
+          } else if (rc != SQLITE_OK) {
+               fprintf(stderr, "「Z O B」— Could not remove feed: %s\n", sqlite3_errmsg(ctx->db));
+               return -1;
+          }
+          printf("「Z O B」— The feed has been released.\n");
+     } else if (strcmp(command, "list") == 0) {
+          listFeeds(ctx);
+     } else if (strcmp(command, "refresh") == 0) {
+          refreshDueFeeds(ctx);
+     } else if (strcmp(command, "search") == 0 && argc > 3) {
+          searchArticles(ctx, argc, argv);
+     } else {
+          fprintf(stderr,
+                  "「Z O B」— A leaf falls: try add <url> [name], remove <id>, list, "
+                  "refresh or search <query>\n");
+          return -1;
+     }
+     return 0;
 }
 
-char *trimWhitespace(char *str) {
-     char *end;
-     while (isspace((unsigned char)*str)) str++;
+/* Formats a duration in seconds as its largest whole unit: 45m, 6h, 2d */
+static void formatInterval(long seconds, char *dst, size_t size) {
+     if (seconds >= 86400) snprintf(dst, size, "%ldd", seconds / 86400);
+     else if (seconds >= 3600) snprintf(dst, size, "%ldh", seconds / 3600);
+     else snprintf(dst, size, "%ldm", seconds / 60);
+}
 
-     if (*str == 0) return str;
+void listFeeds(struct FetchContext *ctx) {
+     time_t now = time(NULL);
+     char every[16], due[16];
 
-     end = str + strlen(str) - 1;
-     while (end > str && isspace((unsigned char)*end)) end--;
+     printf("\n「Z O B」— Feeds in the stream:\n");
+     printf("| %-4s | %-40s | %-6s | %-8s |\n", "ID", "Name", "Every", "Due in");
+     for (int i = 0; i < ctx->numSubs; ++i) {
+          const struct Subscription *sub = &ctx->subs[i];
+          formatInterval(sub->interval, every, sizeof(every));
+          if (sub->nextPoll <= now) snprintf(due, sizeof(due), "now");
+          else formatInterval(sub->nextPoll - now, due, sizeof(due));
+          printf("| %-4d | %-40.40s | %-6s | %-8s |\n", sub->id, sub->name, every, due);
+     }
+}
 
-     end[1] = '\0';
+/* Fetches just the feeds whose adaptive poll time has come */
+void refreshDueFeeds(struct FetchContext *ctx) {
+     struct Subscription *due;
+     int count;
 
-     // Remove CDATA
-     char *cdataStart = strstr(str, "<![CDATA[");
-     if (cdataStart) {
-          char *cdataEnd = strstr(str, "]]>");
-          if (cdataEnd && cdataEnd > cdataStart) {
-               cdataStart += 9;  // Length of the CDATA tag
-               size_t newLength = (cdataEnd - cdataStart);
-               memmove(str, cdataStart, newLength);
-               str[newLength] = '\0';
-          }
+     if (rssFeedsLoad(ctx->db, true, time(NULL), &due, &count) != SQLITE_OK) {
+          fprintf(stderr, "Failed to load feeds: %s\n", sqlite3_errmsg(ctx->db));
+          free(due);
+          return;
      }
-     return str;
+     printf("「Z O B」— %d feeds are due.\n", count);
+
+     ctx->quiet = true;
+     httpGetAll(ctx, due, count);
+     ctx->quiet = false;
+     free(due);
 }
 
-static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb,
-                                  struct MemoryStruct *mem) {
-     size_t realsize = size * nmemb;
+static void renderSearchHit(const struct RssSearchHit *hit, void *userdata) {
+     int *number = userdata;
+     printf(
+         "#%-5d\033[1m\033[36m「%s」\033[0m \033[32m%s\033[0m \033[2m%s\033[0m\n\t\t"
+         "%s\n\033[34m\t\t%s\033[0m\n\n",
+         ++*number, hit->title, hit->pubDate, hit->feed, hit->snippet, hit->link);
+}
 
-     char *ptr = realloc(mem->memory, mem->size + realsize + 1);
-     if (!ptr) {
-          fprintf(stderr, "not enough memory (realloc returned NULL)\n");
-          return 0;
+/* The query is every word after `search`, so it needs no shell quoting */
+void searchArticles(struct FetchContext *ctx, int argc, char **argv) {
+     char query[512] = "";
+     size_t len = 0;
+     for (int i = 3; i < argc && len < sizeof(query); ++i) {
+          len += snprintf(query + len, sizeof(query) - len, "%s%s", i > 3 ? " " : "", argv[i]);
      }
 
-     mem->memory = ptr;
-     memcpy(&(mem->memory[mem->size]), contents, realsize);
-     mem->size += realsize;
-     mem->memory[mem->size] = 0;
+     int number = 0;
+     if (rssArchiveSearch(ctx->db, query, RSS_SEARCH_LIMIT, renderSearchHit, &number) < 0) {
+          fprintf(stderr, "「Z O B」— Search failed: %s\n", sqlite3_errmsg(ctx->db));
+     } else if (number == 0) {
+          printf("「Z O B」— The archive holds nothing on \"%s\".\n", query);
+     }
+}
 
-     return realsize;
+/* The daemon's lock file in the ZOB_DIRECTORY; false if HOME is not set */
+static bool daemonLockPath(char *path, size_t size) {
+     const char *homeDir = getenv("HOME");
+     if (!homeDir) return false;
+     snprintf(path, size, "%s%s/rss-daemon.lock", homeDir, ZOB_DIRECTORY);
+     return true;
+}
+
+/**
+ * Takes a write lock on the whole of the daemon's lock file without
+ * blocking. It is an fcntl() lock, so daemonRunning() can see it without
+ * taking it.
+ *
+ * @return The locked descriptor, -1 if a daemon holds the lock, or -2 if
+ * the lock file cannot be opened.
+ */
+int daemonLock(void) {
+     char path[512];
+     struct flock lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+     if (!daemonLockPath(path, sizeof(path))) return -2;
+
+     int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+     if (fd < 0) return -2;
+     if (fcntl(fd, F_SETLK, &lock) != 0) {
+          close(fd);
+          return -1;
+     }
+     return fd;
 }
 
-void parse_rss(const char *rss_content) {
-     int itemCount = 1;
-     const char *itemStart = rss_content;
-     const char *titleStart, *titleEnd;
-     const char *linkStart, *linkEnd;
-     const char *descriptionStart, *descriptionEnd;
-     const char *pubDateStart, *pubDateEnd;
-
-     while ((itemStart = strstr(itemStart, "<item>"))) {
-          itemStart += 6;
-
-          titleStart = strstr(itemStart, "<title>") + 7;
-          titleEnd = strstr(titleStart, "</title>");
-          linkStart = strstr(itemStart, "<link>") + 6;
-          linkEnd = strstr(linkStart, "</link>");
-          descriptionStart = strstr(itemStart, "<description>") + 13;
-          descriptionEnd = strstr(descriptionStart, "</description>");
-          pubDateStart = strstr(itemStart, "<pubDate>") + 9;
-          pubDateEnd = strstr(pubDateStart, "</pubDate>");
-
-          char title[512] = {0}, link[512] = {0}, description[1024] = {0}, pubDate[512] = {0},
-               dateFormatted[20] = {0};
-
-          strncpy(title, titleStart, titleEnd - titleStart);
-          strncpy(link, linkStart, linkEnd - linkStart);
-          strncpy(description, descriptionStart, descriptionEnd - descriptionStart);
-          strncpy(pubDate, pubDateStart, pubDateEnd - pubDateStart);
-
-          int day, year;
-          char month[20];
-          /* All the big sites use <pubDate>Thu, 14 Mar 2024 20:25:28 +0000</pubDate>
-           * ... I only want DD <Month> YYYY
-           */
-          if (sscanf(pubDate, "%*[^,], %d %s %d", &day, month, &year) == 3) {
-               snprintf(dateFormatted, sizeof(dateFormatted), "%d %s %d", day, month, year);
+/**
+ * Whether a daemon holds its lock. The lock is only queried (F_GETLK), so
+ * a daemon starting at the same moment still gets it.
+ */
+bool daemonRunning(void) {
+     char path[512];
+     struct flock lock = {.l_type = F_RDLCK, .l_whence = SEEK_SET};
+     if (!daemonLockPath(path, sizeof(path))) return false;
+
+     int fd = open(path, O_RDONLY | O_CLOEXEC);
+     if (fd < 0) return false;
+     bool running = fcntl(fd, F_GETLK, &lock) == 0 && lock.l_type != F_UNLCK;
+     close(fd);
+     return running;
+}
+
+/**
+ * Background prefetcher: `zob rss --daemon`.
+ *
+ * Sleeps on a timerfd armed for the earliest next poll in the registry
+ * (capped at RSS_DAEMON_MAX_SLEEP so newly added feeds are noticed), then
+ * refreshes whatever is due into the database. SIGINT/SIGTERM arrive on a
+ * signalfd in the same poll set, so the process is idle between polls.
+ */
+void runRssDaemon(struct FetchContext *ctx) {
+     if (!ctx->db) {
+          fprintf(stderr, "「Z O B」— The daemon needs the zob database, which is unreachable.\n");
+          return;
+     }
+
+     int lock = daemonLock();
+     if (lock < 0) {
+          fprintf(stderr, lock == -1 ? "「Z O B」— Another daemon already tends the feeds.\n"
+                                     : "「Z O B」— Cannot create the daemon's lock file.\n");
+          return;
+     }
+
+     sigset_t signals;
+     sigemptyset(&signals);
+     sigaddset(&signals, SIGINT);
+     sigaddset(&signals, SIGTERM);
+     sigprocmask(SIG_BLOCK, &signals, NULL);
+
+     int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+     int sig = signalfd(-1, &signals, SFD_CLOEXEC);
+     if (timer < 0 || sig < 0) {
+          perror("「Z O B」— Failed to set up the daemon");
+          close(timer);
+          close(sig);
+          close(lock);
+          return;
+     }
+
+     ctx->quiet = true;
+     printf("「Z O B」— The daemon tends the feeds.\n");
+     while (1) {
+          refreshDueFeeds(ctx);
+          fflush(stdout);
+
+          time_t now = time(NULL);
+          time_t next = rssFeedsNextPoll(ctx->db);
+          long delay = next > now ? (long)(next - now) : 0;
+          if (!next || delay > RSS_DAEMON_MAX_SLEEP) delay = RSS_DAEMON_MAX_SLEEP;
+          /* A feed the refresh couldn't reschedule must not turn into a busy loop */
+          if (delay < RSS_DAEMON_MIN_SLEEP) delay = RSS_DAEMON_MIN_SLEEP;
+
+          struct itimerspec when = {.it_value = {.tv_sec = delay}};
+          timerfd_settime(timer, 0, &when, NULL);
+
+          struct pollfd fds[2] = {{.fd = timer, .events = POLLIN}, {.fd = sig, .events = POLLIN}};
+          int ready;
+          while ((ready = poll(fds, 2, -1)) < 0 && errno == EINTR)
+               ;
+          if (ready < 0) {
+               perror("「Z O B」— The daemon can no longer wait");
+               break;
+          }
+          if (fds[1].revents & POLLIN) break;
+
+          uint64_t expirations;
+          if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+               perror("「Z O B」— The daemon's timer failed");
+               break;
           }
+     }
+
+     printf("「Z O B」— The daemon rests.\n");
+     close(timer);
+     close(sig);
+     close(lock);
+}
 
-          printf(
-              "#%-5d\033[1m\033[36m「%s」\033[0m \033[32m%s\033[0m \n\t\t"
-              "%s\n\033[34m\t\t%s\033[0m\n\n",
-              itemCount++, trimWhitespace(title), dateFormatted, trimWhitespace(description),
-              trimWhitespace(link));
+void displayRssMenu(const struct FetchContext *ctx) {
+     printf("\n「Z O B」— Zen RSS\n\n");
+     for (int i = 0; i < ctx->numSubs; ++i) {
+          printf("%d. %s\n", i + 1, ctx->subs[i].name);
+     }
+     printf("%d. All publications\n", ctx->numSubs + 1);
+     printf("%d. Show %s\n", ctx->numSubs + 2, ctx->newOnly ? "all articles" : "only new articles");
+     printf("%d. Exit\n\n", ctx->numSubs + 3);
+     printf("Select the source or exit: ");
+}
+
+static size_t WriteRssCallback(void *contents, size_t size, size_t nmemb,
+                               struct FeedFetch *fetch) {
+     size_t realsize = size * nmemb;
+     fetch->decodedBytes += realsize;
+
+     /* Returning short aborts the transfer: we have all the items we'll show */
+     if (!parse_rss(&fetch->parser, contents, realsize)) return 0;
+     return realsize;
+}
 
-          itemStart = descriptionEnd;
+void collectItem(const struct RssItem *item, void *userdata) {
+     struct FeedFetch *fetch = userdata;
+     fetch->feed->items[fetch->feed->count++] = *item;
+     if (fetch->live && renderItem(fetch->ctx, fetch->feed->count, item)) {
+          fetch->shown++;
+          fflush(stdout);
      }
 }
 
+/**
+ * Prints an item and marks it seen. In the new-only view an item that was
+ * seen before is skipped; that check is a single probe of the mapped set.
+ *
+ * @return true if the item was printed.
+ */
+bool renderItem(struct FetchContext *ctx, int number, const struct RssItem *item) {
+     if (ctx->newOnly && seenSetContains(&ctx->seen, item->id)) return false;
+     seenSetAdd(&ctx->seen, item->id);
+
+     printf(
+         "#%-5d\033[1m\033[36m「%s」\033[0m \033[32m%s\033[0m \n\t\t"
+         "%s\n\033[34m\t\t%s\033[0m\n\n",
+         number, item->title, item->pubDate, item->description, item->link);
+     return true;
+}
+
+int renderRss(struct FetchContext *ctx, const struct RssFeed *feed) {
+     int shown = 0;
+     for (int i = 0; i < feed->count; ++i) shown += renderItem(ctx, i + 1, &feed->items[i]);
+     return shown;
+}
+
+void renderNothingNew(const struct FetchContext *ctx, int shown) {
+     if (ctx->newOnly && shown == 0) printf("「Z O B」— Nothing new under the sun.\n");
+}
+
 size_t write_data(void *ptr, size_t size, size_t nmemb, FILE *stream) {
      size_t written = fwrite(ptr, size, nmemb, stream);
      return written;
 }
 
-void httpGet(const char *url) {
-     CURL *curl = curl_easy_init();
-     if (!curl) {
-          fprintf(stderr, "Failed to initialize cURL\n");
-          return;
+int fetchContextInit(struct FetchContext *ctx) {
+     memset(ctx, 0, sizeof(*ctx));
+     ctx->seen.fd = -1;
+     if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) return -1;
+
+     ctx->share = curl_share_init();
+     ctx->curl = curl_easy_init();
+     ctx->feed = malloc(sizeof(struct RssFeed));
+     if (!ctx->share || !ctx->curl || !ctx->feed) {
+          fetchContextCleanup(ctx);
+          return -1;
      }
 
-     struct MemoryStruct chunk;
-     /* Will be grown as needed by the above realloc */
-     chunk.memory = malloc(1);
-     chunk.size = 0;
+     curl_share_setopt(ctx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+     curl_share_setopt(ctx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+     curl_share_setopt(ctx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+     curl_easy_setopt(ctx->curl, CURLOPT_SHARE, ctx->share);
+     curl_easy_setopt(ctx->curl, CURLOPT_TCP_KEEPALIVE, 1L);
 
-     curl_easy_setopt(curl, CURLOPT_URL, url);
-     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-     curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
+     /* Without the seen set every item simply counts as new */
+     char seenPath[512];
+     const char *homeDir = getenv("HOME");
+     snprintf(seenPath, sizeof(seenPath), "%s%s/rss-seen.bin", homeDir ? homeDir : ".",
+              ZOB_DIRECTORY);
+     seenSetOpen(&ctx->seen, seenPath);
+
+     if (rssStoreOpen(&ctx->db) != SQLITE_OK) {
+          fprintf(stderr, "「Z O B」— The feed cache is unreachable; fetching without it.\n");
+     }
+
+     if (ctx->db && rssFeedsLoad(ctx->db, false, 0, &ctx->subs, &ctx->numSubs) == SQLITE_OK) {
+          return 0;
+     }
+     free(ctx->subs);
+     ctx->subs = calloc(NUM_PUBLICATIONS, sizeof(struct Subscription));
+     if (!ctx->subs) {
+          fetchContextCleanup(ctx);
+          return -1;
+     }
+     for (int i = 0; i < NUM_PUBLICATIONS; ++i) {
+          ctx->subs[i].id = publications[i].id;
+          snprintf(ctx->subs[i].name, sizeof(ctx->subs[i].name), "%s", publications[i].name);
+          snprintf(ctx->subs[i].url, sizeof(ctx->subs[i].url), "%s", publications[i].url);
+     }
+     ctx->numSubs = NUM_PUBLICATIONS;
+     return 0;
+}
+
+void fetchContextCleanup(struct FetchContext *ctx) {
+     /* Easy handles must let go of the share before it can be cleaned up */
+     curl_easy_cleanup(ctx->curl);
+     curl_share_cleanup(ctx->share);
+     /* The zob database connection is shared and closes with the process */
+     seenSetClose(&ctx->seen);
+     free(ctx->feed);
+     free(ctx->subs);
+     ctx->subs = NULL;
+     ctx->numSubs = 0;
+     ctx->curl = NULL;
+     ctx->share = NULL;
+     ctx->db = NULL;
+     ctx->feed = NULL;
+     curl_global_cleanup();
+}
+
+/**
+ * Points an easy handle at a feed, adding the cached validators as
+ * If-None-Match / If-Modified-Since so an unchanged feed answers 304.
+ */
+void fetchPrepare(struct FetchContext *ctx, CURL *curl, struct FeedFetch *fetch) {
+     char etag[256], lastModified[64], header[320];
+
+     fetch->ctx = ctx;
+     fetch->headers = NULL;
+     fetch->shown = 0;
+     fetch->decodedBytes = 0;
+     fetch->feed->count = 0;
+     rssParserInit(&fetch->parser, collectItem, fetch);
+
+     if (ctx->db && rssCacheValidators(ctx->db, fetch->url, etag, sizeof(etag), lastModified,
+                                       sizeof(lastModified))) {
+          if (etag[0]) {
+               snprintf(header, sizeof(header), "If-None-Match: %s", etag);
+               fetch->headers = curl_slist_append(fetch->headers, header);
+          }
+          if (lastModified[0]) {
+               snprintf(header, sizeof(header), "If-Modified-Since: %s", lastModified);
+               fetch->headers = curl_slist_append(fetch->headers, header);
+          }
+     }
+
+     curl_easy_setopt(curl, CURLOPT_URL, fetch->url);
+     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, fetch->headers);
+     /* Offer every encoding libcurl was built with; it inflates as a stream */
+     curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteRssCallback);
+     curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)fetch);
+}
+
+/* Reports how much the feed cost on the wire against what the parser saw */
+static void renderFetchStats(CURL *curl, const struct FeedFetch *fetch) {
+     curl_off_t wireBytes = 0;
+     curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wireBytes);
+     printf("\033[2m「Z O B」— %.1f KiB on the wire, %.1f KiB decoded\033[0m\n",
+            wireBytes / 1024.0, fetch->decodedBytes / 1024.0);
+}
+
+/* Copies a response header's value into `dst`, or leaves it empty */
+static void responseHeader(CURL *curl, const char *name, char *dst, size_t size) {
+     struct curl_header *header;
+     dst[0] = '\0';
+     if (curl_easy_header(curl, name, 0, CURLH_HEADER, -1, &header) == CURLHE_OK) {
+          snprintf(dst, size, "%s", header->value);
+     }
+}
+
+/**
+ * Settles a completed transfer: 304 is rendered from the cache (the body was
+ * empty, so nothing was parsed), 200 is written back to the cache, and a
+ * transfer error or any other status counts as a failure. Whichever it was,
+ * the feed's next poll is rescheduled.
+ */
+void fetchFinish(struct FetchContext *ctx, CURL *curl, struct FeedFetch *fetch, CURLcode res) {
+     long status = 0;
+     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+
+     /* A write error is how we stop early once MAX_ARTICLES items are in */
+     if (res == CURLE_WRITE_ERROR && fetch->parser.count >= MAX_ARTICLES) res = CURLE_OK;
+     bool failed = res != CURLE_OK || (status != 200 && status != 304);
 
-     CURLcode res = curl_easy_perform(curl);
      if (res != CURLE_OK) {
           fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+     } else if (status == 304) {
+          if (ctx->quiet) {
+               printf("「Z O B」— %s: unchanged\n", fetch->name);
+          } else if (ctx->db && rssCacheItems(ctx->db, fetch->url, fetch->feed) > 0) {
+               renderNothingNew(ctx, renderRss(ctx, fetch->feed));
+               renderFetchStats(curl, fetch);
+          }
+          if (ctx->db) rssFeedSchedule(ctx->db, fetch->url, NULL, false, time(NULL));
      } else {
-          parse_rss(chunk.memory);
+          if (ctx->quiet && failed) {
+               printf("「Z O B」— %s: HTTP %ld\n", fetch->name, status);
+          } else if (ctx->quiet) {
+               printf("「Z O B」— %s: %d items\n", fetch->name, fetch->feed->count);
+          } else {
+               if (!fetch->live) fetch->shown = renderRss(ctx, fetch->feed);
+               renderNothingNew(ctx, fetch->shown);
+               renderFetchStats(curl, fetch);
+          }
+
+          if (ctx->db && status == 200) {
+               char etag[256], lastModified[64];
+               responseHeader(curl, "ETag", etag, sizeof(etag));
+               responseHeader(curl, "Last-Modified", lastModified, sizeof(lastModified));
+               rssFeedSchedule(ctx->db, fetch->url, fetch->feed, false, time(NULL));
+               rssCacheSave(ctx->db, fetch->name, fetch->url, etag, lastModified, fetch->feed);
+          }
+     }
+     if (ctx->db && failed) rssFeedSchedule(ctx->db, fetch->url, NULL, true, time(NULL));
+
+     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+     curl_slist_free_all(fetch->headers);
+     fetch->headers = NULL;
+}
+
+/* Offline mode: render whatever the last successful fetch left behind */
+void renderCached(struct FetchContext *ctx, const char *url) {
+     if (!ctx->db || rssCacheItems(ctx->db, url, ctx->feed) == 0) {
+          printf("「Z O B」— Nothing cached for this feed yet.\n");
+          return;
+     }
+     renderNothingNew(ctx, renderRss(ctx, ctx->feed));
+}
+
+void httpGet(struct FetchContext *ctx, const struct Subscription *sub) {
+     /* The parser holds a whole item, so keep it off the stack */
+     static struct FeedFetch fetch;
+
+     if (ctx->offline) {
+          renderCached(ctx, sub->url);
+          return;
+     }
+
+     fetch.name = sub->name;
+     fetch.url = sub->url;
+     fetch.feed = ctx->feed;
+     fetch.live = true;
+     fetchPrepare(ctx, ctx->curl, &fetch);
+     CURLcode res = curl_easy_perform(ctx->curl);
+     fetchFinish(ctx, ctx->curl, &fetch, res);
+}
+
+/* Starts the transfer for one feed on the multi handle, with its own easy handle */
+static int startFetch(struct FetchContext *ctx, CURLM *multi, struct FeedFetch *fetch) {
+     CURL *curl = curl_easy_init();
+     fetch->feed = malloc(sizeof(struct RssFeed));
+     if (!curl || !fetch->feed) {
+          fprintf(stderr, "Failed to initialize cURL for %s\n", fetch->name);
+          curl_easy_cleanup(curl);
+          free(fetch->feed);
+          fetch->feed = NULL;
+          return -1;
      }
 
-     free(chunk.memory);
-     curl_easy_cleanup(curl);
+     fetch->curl = curl;
+     fetchPrepare(ctx, curl, fetch);
+     curl_easy_setopt(curl, CURLOPT_SHARE, ctx->share);
+#if RSS_HTTP2_MULTIPLEX
+     /* h2 is only negotiated over TLS; waiting on a plain http origin would serialize it */
+     if (strncmp(fetch->url, "https://", 8) == 0) {
+          curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+          curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+     }
+#endif
+     curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)fetch);
+     curl_multi_add_handle(multi, curl);
+     return 0;
 }
 
+/**
+ * Fetches a set of feeds concurrently on a single curl multi handle.
+ *
+ * Each feed gets its own easy handle and parser, and is rendered as soon as
+ * its transfer completes, so total wall time is that of the slowest feed
+ * rather than the sum of all of them. At most RSS_MAX_PARALLEL transfers
+ * are in flight; the next one starts as soon as a slot frees up, which
+ * keeps memory bounded however long the feed list is.
+ */
+void httpGetAll(struct FetchContext *ctx, const struct Subscription *subs, int count) {
+     if (ctx->offline) {
+          for (int i = 0; i < count; ++i) {
+               printf("\n\033[1m「Z O B」— %s\033[0m\n\n", subs[i].name);
+               renderCached(ctx, subs[i].url);
+          }
+          return;
+     }
+
+     CURLM *multi = curl_multi_init();
+     struct FeedFetch *fetches = calloc(count ? count : 1, sizeof(struct FeedFetch));
+     if (!multi || !fetches) {
+          fprintf(stderr, "Failed to initialize cURL multi handle\n");
+          curl_multi_cleanup(multi);
+          free(fetches);
+          return;
+     }
+#if RSS_HTTP2_MULTIPLEX
+     curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#else
+     curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+#endif
+
+     int next = 0, inFlight = 0, running = 0;
+     do {
+          while (next < count && inFlight < RSS_MAX_PARALLEL) {
+               fetches[next].name = subs[next].name;
+               fetches[next].url = subs[next].url;
+               if (startFetch(ctx, multi, &fetches[next]) == 0) inFlight++;
+               next++;
+          }
+
+          CURLMcode mc = curl_multi_perform(multi, &running);
+          if (mc == CURLM_OK && running) mc = curl_multi_poll(multi, NULL, 0, 1000, NULL);
+          if (mc != CURLM_OK) {
+               fprintf(stderr, "curl_multi_perform() failed: %s\n", curl_multi_strerror(mc));
+               break;
+          }
+
+          /* Render whichever feeds have finished since the last pass */
+          CURLMsg *msg;
+          int queued;
+          while ((msg = curl_multi_info_read(multi, &queued))) {
+               if (msg->msg != CURLMSG_DONE) continue;
+
+               CURL *curl = msg->easy_handle;
+               struct FeedFetch *fetch;
+               curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&fetch);
+
+               if (!ctx->quiet) printf("\n\033[1m「Z O B」— %s\033[0m\n\n", fetch->name);
+               fetchFinish(ctx, curl, fetch, msg->data.result);
+
+               curl_multi_remove_handle(multi, curl);
+               curl_easy_cleanup(curl);
+               free(fetch->feed);
+               fetch->feed = NULL;
+               inFlight--;
+          }
+     } while (inFlight > 0 || next < count);
+
+     /* Anything still attached was abandoned by an error above */
+     for (int i = 0; i < next; ++i) {
+          if (!fetches[i].feed) continue;
+          CURL *curl = fetches[i].curl;
+          curl_multi_remove_handle(multi, curl);
+          curl_easy_cleanup(curl);
+          curl_slist_free_all(fetches[i].headers);
+          free(fetches[i].feed);
+     }
+     free(fetches);
+     curl_multi_cleanup(multi);
+}
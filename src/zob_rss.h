@@ -1,6 +1,6 @@
 #ifndef ZOB_RSS_H
 #define ZOB_RSS_H
 
-void runRss();
+void runRss(int argc, char **argv);
 
 #endif // ZOB_RSS_H
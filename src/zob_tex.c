@@ -1,279 +1,1355 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+/* Vector scans where the target has them; -DTEX_NO_SIMD builds the table scans alone */
+#if defined(__AVX2__) && !defined(TEX_NO_SIMD)
+#define TEX_AVX2 1
+#elif defined(__SSE2__) && !defined(TEX_NO_SIMD)
+#define TEX_SSE2 1
+#endif
+#if defined(TEX_AVX2) || defined(TEX_SSE2)
+#include <immintrin.h>
+#endif
+/* -DTEX_NO_ESCAPES passes text through unescaped, for timing what escaping costs */
 
-typedef enum {
-     TOKEN_TEXT,
-     TOKEN_HEADER1,
-     TOKEN_HEADER2,
-     TOKEN_BOLD,
-     TOKEN_ITALIC,
-     TOKEN_LINK,
-     TOKEN_LIST_ITEM,
-     TOKEN_CODE_BLOCK,
-     TOKEN_NEWLINE
-} TokenType;
-
-typedef struct Token {
-     TokenType type;
-     char *content;
-     struct Token *next;
-} Token;
-
-Token *createToken(TokenType type, const char *content) {
-     Token *token = malloc(sizeof(Token));
-     if (token == NULL) return NULL;
-     token->type = type;
-     token->content = strdup(content);
-     if (token->content == NULL) {
-          free(token);
-          return NULL;
-     }
-     token->next = NULL;
-     return token;
+#include "zob_tex.h"
+
+#include "config.h"
+#include "utils/arena.h"
+#include "utils/hash.h"
+#include "utils/input_file.h"
+#include "utils/outbuf.h"
+#include "utils/tex_cache.h"
+
+void tokenListInit(TokenList *list) {
+     memset(list, 0, sizeof(*list));
+     arenaInit(&list->arena);
 }
 
-void freeTokens(Token *token) {
-     while (token) {
-          Token *next = token->next;
-          free(token->content);
-          free(token);
-          token = next;
+void tokenListFree(TokenList *list) {
+     free(list->tokens);
+     arenaFree(&list->arena);
+     memset(list, 0, sizeof(*list));
+}
+
+static bool pushToken(TokenList *list, const Token *token) {
+     if (list->count == list->capacity) {
+          size_t capacity = list->capacity ? 2 * list->capacity : 1024;
+          Token *grown = realloc(list->tokens, capacity * sizeof(Token));
+          if (!grown) return false;
+          list->tokens = grown;
+          list->capacity = capacity;
      }
+     list->tokens[list->count++] = *token;
+     return true;
 }
 
-char *readFileIntoString(const char *filename) {
-     FILE *file = fopen(filename, "r");
-     if (file == NULL) {
-          fprintf(stderr, "Error opening file: %s\n", filename);
-          return NULL;
+/**
+ * Pull tokenizer: hands out one token per nextToken() call, so a document
+ * can be converted as it is read without holding all of its tokens.
+ * Synthesized token text is allocated from `arena`; streaming callers reset
+ * it between tokens.
+ */
+typedef struct {
+     const char *ptr;
+     const char *end;
+     /* Tokens only start before this point, though the last may run past it */
+     const char *limit;
+     bool insideCodeBlock;
+     struct Arena *arena;
+     /* Set when the arena runs out of memory; tokenizing stops there */
+     bool failed;
+} Tokenizer;
+
+void tokenizerInit(Tokenizer *tokenizer, const char *markdown, size_t length,
+                   struct Arena *arena) {
+     tokenizer->ptr = markdown;
+     tokenizer->end = markdown + length;
+     tokenizer->limit = tokenizer->end;
+     tokenizer->insideCodeBlock = false;
+     tokenizer->arena = arena;
+     tokenizer->failed = false;
+}
+
+/* Skips one delimiter, unless the source ends first */
+static const char *skip(const char *ptr, const char *end) { return ptr < end ? ptr + 1 : ptr; }
+
+/**
+ * Bytes that can end a run of plain text. '`' and '-' only do so as part of
+ * "```" and "- ", which the caller checks.
+ */
+static const bool TEXT_STOP[256] = {
+    ['\n'] = true, ['*'] = true, ['['] = true, ['`'] = true, ['#'] = true, ['-'] = true,
+};
+
+/**
+ * What each byte that LaTeX would take as markup becomes in text; NULL for
+ * bytes that stand for themselves.
+ */
+#if !defined(TEX_NO_ESCAPES)
+static const char *const LATEX_ESCAPES[256] = {
+    ['#'] = "\\#", ['$'] = "\\$", ['%'] = "\\%", ['&'] = "\\&", ['_'] = "\\_",
+    ['{'] = "\\{", ['}'] = "\\}", ['~'] = "\\textasciitilde{}", ['^'] = "\\textasciicircum{}",
+    ['\\'] = "\\textbackslash{}",
+};
+
+/* Inside \href's URL, hyperref copes with everything but these */
+static const char *const URL_ESCAPES[256] = {['#'] = "\\#", ['%'] = "\\%"};
+#else
+static const char *const LATEX_ESCAPES[256] = {NULL};
+static const char *const URL_ESCAPES[256] = {NULL};
+#endif
+
+/* Longest entry in either table, for sizing escaped copies */
+#define MAX_ESCAPE_LENGTH (sizeof("\\textasciicircum{}") - 1)
+
+#if defined(TEX_NO_ESCAPES) && defined(TEX_AVX2)
+static inline __m256i escapeHits(__m256i chunk) { return _mm256_xor_si256(chunk, chunk); }
+#elif defined(TEX_NO_ESCAPES) && defined(TEX_SSE2)
+static inline __m128i escapeHits(__m128i chunk) { return _mm_xor_si128(chunk, chunk); }
+#elif defined(TEX_AVX2)
+/* Lanes of `chunk` holding a byte with an entry in LATEX_ESCAPES */
+static inline __m256i escapeHits(__m256i chunk) {
+     /* '#' through '&' are adjacent: one unsigned range test covers them */
+     __m256i low = _mm256_sub_epi8(chunk, _mm256_set1_epi8('#'));
+     __m256i hits = _mm256_cmpeq_epi8(_mm256_min_epu8(low, _mm256_set1_epi8(3)), low);
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('{')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('}')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('~')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('^')));
+     return _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\')));
+}
+#elif defined(TEX_SSE2)
+/* Lanes of `chunk` holding a byte with an entry in LATEX_ESCAPES */
+static inline __m128i escapeHits(__m128i chunk) {
+     /* '#' through '&' are adjacent: one unsigned range test covers them */
+     __m128i low = _mm_sub_epi8(chunk, _mm_set1_epi8('#'));
+     __m128i hits = _mm_cmpeq_epi8(_mm_min_epu8(low, _mm_set1_epi8(3)), low);
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('{')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('}')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('~')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('^')));
+     return _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')));
+}
+#endif
+
+/*
+ * Lanes of `chunk` that scanText() must look at: the TEXT_STOP bytes and
+ * LATEX_ESCAPES' other than '#', which is a stop anyway. Setting bit 5
+ * first folds the two sets onto five tests, since it maps '\n' onto '*',
+ * '[' to '_' onto '{' to DEL, and leaves the rest where they are. The price
+ * is a few bytes that fold onto them too and are let through for the tables
+ * to turn away: CR, '@', ']', '|', DEL and controls 3 to 6. Built with
+ * TEX_NO_ESCAPES, it is the TEXT_STOP bytes alone.
+ */
+#if defined(TEX_NO_ESCAPES) && defined(TEX_AVX2)
+static inline __m256i textHits(__m256i chunk) {
+     __m256i hits = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('*')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('[')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('`')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('#')));
+     return _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('-')));
+}
+#elif defined(TEX_NO_ESCAPES) && defined(TEX_SSE2)
+static inline __m128i textHits(__m128i chunk) {
+     __m128i hits = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('*')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('[')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('`')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('#')));
+     return _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('-')));
+}
+#elif defined(TEX_AVX2)
+static inline __m256i textHits(__m256i chunk) {
+     __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+     /* '#' to '&' is one unsigned range, '{' to DEL everything above 'z' */
+     __m256i hash = _mm256_sub_epi8(folded, _mm256_set1_epi8('#'));
+     __m256i hits = _mm256_cmpeq_epi8(_mm256_min_epu8(hash, _mm256_set1_epi8(3)), hash);
+     hits = _mm256_or_si256(hits, _mm256_cmpgt_epi8(folded, _mm256_set1_epi8('z')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('`')));
+     hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('*')));
+     return _mm256_or_si256(hits, _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('-')));
+}
+#elif defined(TEX_SSE2)
+static inline __m128i textHits(__m128i chunk) {
+     __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+     /* '#' to '&' is one unsigned range, '{' to DEL everything above 'z' */
+     __m128i hash = _mm_sub_epi8(folded, _mm_set1_epi8('#'));
+     __m128i hits = _mm_cmpeq_epi8(_mm_min_epu8(hash, _mm_set1_epi8(3)), hash);
+     hits = _mm_or_si128(hits, _mm_cmpgt_epi8(folded, _mm_set1_epi8('z')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(folded, _mm_set1_epi8('`')));
+     hits = _mm_or_si128(hits, _mm_cmpeq_epi8(folded, _mm_set1_epi8('*')));
+     return _mm_or_si128(hits, _mm_cmpeq_epi8(folded, _mm_set1_epi8('-')));
+}
+#endif
+
+/**
+ * First byte in [ptr, end) that is in TEXT_STOP, or `end`. Sets `*special`
+ * if any byte before it has an entry in LATEX_ESCAPES, so text that needs
+ * no escaping is found out in the same pass.
+ *
+ * Prose is the bulk of a document, so this is the hot loop: with SSE2 (or
+ * AVX2, when built with -mavx2) it tests 16 (32) bytes per iteration, and
+ * only the rare hits go through the tables.
+ */
+static const char *scanText(const char *ptr, const char *end, bool *special) {
+#if defined(TEX_AVX2)
+     for (; end - ptr >= 32; ptr += 32) {
+          __m256i chunk = _mm256_loadu_si256((const __m256i *)ptr);
+          for (unsigned mask = _mm256_movemask_epi8(textHits(chunk)); mask; mask &= mask - 1) {
+               const char *hit = ptr + __builtin_ctz(mask);
+               if (TEXT_STOP[(unsigned char)*hit]) return hit;
+               *special |= LATEX_ESCAPES[(unsigned char)*hit] != NULL;
+          }
      }
+#elif defined(TEX_SSE2)
+     for (; end - ptr >= 16; ptr += 16) {
+          __m128i chunk = _mm_loadu_si128((const __m128i *)ptr);
+          for (unsigned mask = _mm_movemask_epi8(textHits(chunk)); mask; mask &= mask - 1) {
+               const char *hit = ptr + __builtin_ctz(mask);
+               if (TEXT_STOP[(unsigned char)*hit]) return hit;
+               *special |= LATEX_ESCAPES[(unsigned char)*hit] != NULL;
+          }
+     }
+#endif
+     while (ptr < end && !TEXT_STOP[(unsigned char)*ptr]) {
+          *special |= LATEX_ESCAPES[(unsigned char)*ptr] != NULL;
+          ptr++;
+     }
+     return ptr;
+}
 
-     fseek(file, 0, SEEK_END);
-     long fileSize = ftell(file);
-     fseek(file, 0, SEEK_SET);
+/**
+ * First byte in [ptr, end) with an entry in LATEX_ESCAPES, or `end`.
+ *
+ * Most text has nothing to escape, so like scanText() this tests a vector of
+ * bytes at a time, letting the caller copy whole runs at once.
+ */
+static const char *scanEscapes(const char *ptr, const char *end) {
+#if defined(TEX_AVX2)
+     while (end - ptr >= 32) {
+          __m256i chunk = _mm256_loadu_si256((const __m256i *)ptr);
+          unsigned mask = (unsigned)_mm256_movemask_epi8(escapeHits(chunk));
+          if (mask) return ptr + __builtin_ctz(mask);
+          ptr += 32;
+     }
+#elif defined(TEX_SSE2)
+     while (end - ptr >= 16) {
+          __m128i chunk = _mm_loadu_si128((const __m128i *)ptr);
+          unsigned mask = (unsigned)_mm_movemask_epi8(escapeHits(chunk));
+          if (mask) return ptr + __builtin_ctz(mask);
+          ptr += 16;
+     }
+#endif
+     while (ptr < end && !LATEX_ESCAPES[(unsigned char)*ptr]) ptr++;
+     return ptr;
+}
 
-     char *buffer = malloc(fileSize + 1);
-     if (buffer == NULL) {
-          fprintf(stderr, "Memory allocation failed\n");
-          fclose(file);
-          return NULL;
+/**
+ * First `stop` byte in [ptr, end), or `end`. Like scanText(), sets
+ * `*special` if any byte before it has an entry in LATEX_ESCAPES; this one
+ * scans the text of headers, list items and emphasis.
+ */
+static const char *scanUntil(const char *ptr, const char *end, char stop, bool *special) {
+#if defined(TEX_AVX2)
+     for (; end - ptr >= 32; ptr += 32) {
+          __m256i chunk = _mm256_loadu_si256((const __m256i *)ptr);
+          unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(stop)));
+          unsigned escapes = _mm256_movemask_epi8(escapeHits(chunk));
+          if (mask) {
+               *special |= (escapes & ((mask & -mask) - 1)) != 0;
+               return ptr + __builtin_ctz(mask);
+          }
+          *special |= escapes != 0;
+     }
+#elif defined(TEX_SSE2)
+     for (; end - ptr >= 16; ptr += 16) {
+          __m128i chunk = _mm_loadu_si128((const __m128i *)ptr);
+          unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(stop)));
+          unsigned escapes = _mm_movemask_epi8(escapeHits(chunk));
+          if (mask) {
+               *special |= (escapes & ((mask & -mask) - 1)) != 0;
+               return ptr + __builtin_ctz(mask);
+          }
+          *special |= escapes != 0;
+     }
+#endif
+     while (ptr < end && *ptr != stop) {
+          *special |= LATEX_ESCAPES[(unsigned char)*ptr] != NULL;
+          ptr++;
      }
+     return ptr;
+}
 
-     fread(buffer, 1, fileSize, file);
-     buffer[fileSize] = '\0';
-     fclose(file);
+/**
+ * Copies `length` bytes of `src` to `dst`, escaped through `table`, which
+ * must have room for MAX_ESCAPE_LENGTH bytes per source byte.
+ *
+ * @return The number of bytes written.
+ */
+static size_t escapeInto(char *dst, const char *src, size_t length,
+                         const char *const table[256]) {
+#if defined(TEX_NO_ESCAPES)
+     (void)table;
+     memcpy(dst, src, length);
+     return length;
+#endif
+     char *out = dst;
+     for (size_t i = 0; i < length; ++i) {
+          const char *escape = table[(unsigned char)src[i]];
+          if (escape) {
+               size_t escapeLength = strlen(escape);
+               memcpy(out, escape, escapeLength);
+               out += escapeLength;
+          } else {
+               *out++ = src[i];
+          }
+     }
+     return out - dst;
+}
 
-     return buffer;
+/* Whether the source at `ptr` starts with `prefix`, never looking past `end` */
+static bool startsWith(const char *ptr, const char *end, const char *prefix, size_t length) {
+     return (size_t)(end - ptr) >= length && memcmp(ptr, prefix, length) == 0;
 }
 
-Token *tokenizeMarkdown(const char *markdown) {
-     Token *head = NULL;
-     Token **current = &head;
-     bool insideCodeBlock = false;
+/**
+ * Produces the next token of the document. The source is bounded by length
+ * rather than a terminator, so it can be a read-only mapping of the file.
+ *
+ * @return false at the end of the document, or if tokenizing failed.
+ */
+bool nextToken(Tokenizer *tokenizer, Token *token) {
+     const char *ptr = tokenizer->ptr;
+     const char *end = tokenizer->end;
 
-     for (const char *ptr = markdown; *ptr;) {
-          if (insideCodeBlock) {
-               if (strncmp(ptr, "```", 3) == 0) {
+     while (ptr < tokenizer->limit) {
+          if (tokenizer->insideCodeBlock) {
+               if (startsWith(ptr, end, "```", 3)) {
                     ptr += 3;
-                    insideCodeBlock = false;
+                    tokenizer->insideCodeBlock = false;
                     continue;
                }
                const char *start = ptr;
-               while (*ptr && strncmp(ptr, "```", 3) != 0) ptr++;
-               *current = createToken(TOKEN_CODE_BLOCK, strndup(start, ptr - start));
-               if (!*current) return head;
-               current = &(*current)->next;
-               continue;
+               while (ptr < end && !startsWith(ptr, end, "```", 3)) ptr++;
+               *token = (Token){TOKEN_CODE_BLOCK, start, ptr - start, true};
+               tokenizer->ptr = ptr;
+               return true;
           }
 
-          if (strncmp(ptr, "```", 3) == 0) {
+          if (startsWith(ptr, end, "```", 3)) {
                ptr += 3;
-               insideCodeBlock = true;
+               tokenizer->insideCodeBlock = true;
                continue;
           }
 
           if (*ptr == '[') {
                ptr++;
                const char *text_start = ptr;
-               while (*ptr && *ptr != ']') ptr++;
-               char *link_text = strndup(text_start, ptr - text_start);
-               ptr++; /* Skip the closing ] */
-               ptr++; /* Skip the opening ( */
+               while (ptr < end && *ptr != ']') ptr++;
+               int text_length = ptr - text_start;
+               ptr = skip(ptr, end); /* Skip the closing ] */
+               ptr = skip(ptr, end); /* Skip the opening ( */
                const char *url_start = ptr;
-               while (*ptr && *ptr != ')') ptr++;
-               char *url = strndup(url_start, ptr - url_start);
-               ptr++; /* Skip the closing ) */
-
-               char *full_link = malloc(strlen(link_text) + strlen(url) + 32);
-               sprintf(full_link, "\\href{%s}{%s}", url, link_text);
-               *current = createToken(TOKEN_LINK, full_link);
-               free(link_text);
-               free(url);
-               free(full_link);
-               if (!*current) return head;
-               current = &(*current)->next;
-               continue;
+               while (ptr < end && *ptr != ')') ptr++;
+               int url_length = ptr - url_start;
+               ptr = skip(ptr, end); /* Skip the closing ) */
+
+               size_t size = (text_length + url_length) * MAX_ESCAPE_LENGTH + sizeof("\\href{}{}");
+               char *full_link = arenaAlloc(tokenizer->arena, size);
+               if (!full_link) {
+                    tokenizer->failed = true;
+                    return false;
+               }
+               char *out = full_link;
+               out = stpcpy(out, "\\href{");
+               out += escapeInto(out, url_start, url_length, URL_ESCAPES);
+               out = stpcpy(out, "}{");
+               out += escapeInto(out, text_start, text_length, LATEX_ESCAPES);
+               out = stpcpy(out, "}");
+               *token = (Token){TOKEN_LINK, full_link, out - full_link, true};
+               tokenizer->ptr = ptr;
+               return true;
           }
 
           const char *start = ptr;
           TokenType type = TOKEN_TEXT;
           size_t length = 0;
+          bool special = false;
 
           if (*ptr == '\n') {
                ptr++;
                continue;
           }
 
-          if (strncmp(ptr, "# ", 2) == 0) {
+          if (startsWith(ptr, end, "# ", 2)) {
                ptr += 2;
                start = ptr;
                type = TOKEN_HEADER1;
-               while (*ptr && *ptr != '\n') ptr++;
+               ptr = scanUntil(ptr, end, '\n', &special);
                length = ptr - start;
-          } else if (strncmp(ptr, "## ", 3) == 0) {
+          } else if (startsWith(ptr, end, "## ", 3)) {
                ptr += 3;
                start = ptr;
                type = TOKEN_HEADER2;
-               while (*ptr && *ptr != '\n') ptr++;
+               ptr = scanUntil(ptr, end, '\n', &special);
                length = ptr - start;
-          } else if (strncmp(ptr, "**", 2) == 0) {
+          } else if (startsWith(ptr, end, "**", 2)) {
                ptr += 2;
                start = ptr;
                type = TOKEN_BOLD;
-               while (*ptr && strncmp(ptr, "**", 2) != 0) ptr++;
+               while ((ptr = scanUntil(ptr, end, '*', &special)) < end &&
+                      !startsWith(ptr, end, "**", 2))
+                    ptr++;
                length = ptr - start;
-               ptr += 2; /* Skip the closing ** */
+               ptr = skip(skip(ptr, end), end); /* Skip the closing ** */
           } else if (*ptr == '*') {
                ptr++;
                start = ptr;
                type = TOKEN_ITALIC;
-               while (*ptr && *ptr != '*') ptr++;
+               ptr = scanUntil(ptr, end, '*', &special);
                length = ptr - start;
-               ptr++; /* Skip the closing * */
-          } else if (strncmp(ptr, "- ", 2) == 0) {
+               ptr = skip(ptr, end); /* Skip the closing * */
+          } else if (startsWith(ptr, end, "- ", 2)) {
                ptr += 2;
                start = ptr;
                type = TOKEN_LIST_ITEM;
-               while (*ptr && *ptr != '\n') ptr++;
+               ptr = scanUntil(ptr, end, '\n', &special);
                length = ptr - start;
           } else {
                start = ptr;
-               while (*ptr && *ptr != '\n' && *ptr != '*' && strncmp(ptr, "**", 2) != 0 &&
-                      *ptr != '[' && strncmp(ptr, "```", 3) != 0 && strncmp(ptr, "- ", 2) != 0 &&
-                      *ptr != '#')
-                    ptr++;
+               while ((ptr = scanText(ptr, end, &special)) < end) {
+                    if (*ptr == '`' && !startsWith(ptr, end, "```", 3)) {
+                         ptr++;
+                    } else if (*ptr == '-' && !startsWith(ptr, end, "- ", 2)) {
+                         ptr++;
+                    } else {
+                         break;
+                    }
+               }
                length = ptr - start;
           }
 
-          *current = createToken(type, strndup(start, length));
-          if (!*current) return head;
-          current = &(*current)->next;
+          *token = (Token){type, start, length, !special};
+          tokenizer->ptr = skip(ptr, end); /* Move past the last processed character */
+          return true;
+     }
+
+     tokenizer->ptr = ptr;
+     return false;
+}
+
+/**
+ * Splits a whole markdown document into tokens appended to `list`.
+ *
+ * @return false if memory ran out; the tokens produced so far are kept.
+ */
+bool tokenizeMarkdown(const char *markdown, size_t length, TokenList *list) {
+     Tokenizer tokenizer;
+     Token token;
 
-          if (*ptr) ptr++; /* Move past the last processed character */
+     tokenizerInit(&tokenizer, markdown, length, &list->arena);
+     while (nextToken(&tokenizer, &token)) {
+          if (!pushToken(list, &token)) return false;
      }
+     return !tokenizer.failed;
+}
+
+/**
+ * Token-at-a-time LaTeX writer.
+ *
+ * Whether a list item closes its itemize depends on the token after it, so
+ * the close is deferred until that token arrives (or the document ends).
+ */
+typedef struct {
+     struct OutBuf *out;
+     bool insideList;
+     /* Whether anything has been written; block tokens after the first get a newline */
+     bool written;
+} LatexEmitter;
+
+void emitterInit(LatexEmitter *emitter, struct OutBuf *out) {
+     emitter->out = out;
+     emitter->insideList = false;
+     emitter->written = false;
+}
 
-     return head;
+static void emit(LatexEmitter *emitter, const char *text, size_t length) {
+     if (length == 0) return;
+     outBufWrite(emitter->out, text, length);
+     emitter->written = true;
 }
 
-char *convertTokensToLatex(Token *tokens) {
-     size_t totalLength = 0;
-     Token *token;
+static void emitString(LatexEmitter *emitter, const char *str) { emit(emitter, str, strlen(str)); }
+
+/* Writes document text with LaTeX's special characters escaped, runs between them whole */
+static void emitEscaped(LatexEmitter *emitter, const char *text, size_t length) {
+     const char *end = text + length;
+     while (text < end) {
+          const char *special = scanEscapes(text, end);
+          emit(emitter, text, special - text);
+          if (special == end) break;
+          emitString(emitter, LATEX_ESCAPES[(unsigned char)*special]);
+          text = special + 1;
+     }
+}
 
-     for (token = tokens; token; token = token->next) {
-          switch (token->type) {
-               case TOKEN_HEADER1:
-               case TOKEN_HEADER2:
-               case TOKEN_BOLD:
-               case TOKEN_ITALIC:
-               case TOKEN_LINK:
-               case TOKEN_LIST_ITEM:
-               case TOKEN_CODE_BLOCK:
-               case TOKEN_TEXT:
-               case TOKEN_NEWLINE:
-                    totalLength += strlen(token->content) + 50;
-                    break;
+/* A token's text, escaped unless the tokenizer found nothing to escape */
+static void emitText(LatexEmitter *emitter, const Token *token) {
+     if (token->plain) {
+          emit(emitter, token->text, token->length);
+     } else {
+          emitEscaped(emitter, token->text, token->length);
+     }
+}
+
+void emitToken(LatexEmitter *emitter, const Token *token) {
+     if (emitter->insideList && token->type != TOKEN_LIST_ITEM) {
+          emitString(emitter, "\n\\end{itemize}\n");
+          emitter->insideList = false;
+     }
+
+     if (emitter->written &&
+         (token->type == TOKEN_HEADER1 || token->type == TOKEN_HEADER2 ||
+          token->type == TOKEN_LIST_ITEM || token->type == TOKEN_CODE_BLOCK ||
+          token->type == TOKEN_LINK || token->type == TOKEN_NEWLINE)) {
+          emitString(emitter, "\n");
+     }
+
+     switch (token->type) {
+          case TOKEN_HEADER1:
+          case TOKEN_HEADER2:
+               emitString(emitter,
+                          token->type == TOKEN_HEADER1 ? "\n\\section{" : "\n\\subsection{");
+               emitText(emitter, token);
+               emitString(emitter, "}\n\n");
+               break;
+          case TOKEN_BOLD:
+               emitString(emitter, "\\textbf{");
+               emitText(emitter, token);
+               emitString(emitter, "}");
+               break;
+          case TOKEN_ITALIC:
+               emitString(emitter, "\\textbf{");
+               emitText(emitter, token);
+               emitString(emitter, "}");
+               break;
+          case TOKEN_LINK:
+               /* Built, and escaped, by the tokenizer */
+               emit(emitter, token->text, token->length);
+               break;
+          case TOKEN_LIST_ITEM:
+               if (!emitter->insideList) {
+                    emitString(emitter, "\\begin{itemize}\n");
+                    emitter->insideList = true;
+               }
+               emitString(emitter, "     \\item ");
+               emitText(emitter, token);
+               break;
+          case TOKEN_CODE_BLOCK:
+               emitString(emitter, "\\begin{verbatim}\n");
+               /* Verbatim: taken as it is */
+               emit(emitter, token->text, token->length);
+               emitString(emitter, "\\end{verbatim}");
+               break;
+          case TOKEN_NEWLINE:
+               emitString(emitter, "\n");
+               break;
+          case TOKEN_TEXT:
+               emitText(emitter, token);
+               break;
+     }
+}
+
+void emitterFinish(LatexEmitter *emitter) {
+     if (emitter->insideList) {
+          emitString(emitter, "\\end{itemize}\n");
+          emitter->insideList = false;
+     }
+}
+
+/**
+ * Converts a whole token list to one LaTeX string the caller frees.
+ *
+ * @return The string, or NULL if memory ran out.
+ */
+char *convertTokensToLatex(const TokenList *list) {
+     struct OutBuf out;
+     LatexEmitter emitter;
+
+     if (!outBufInit(&out, -1, list->count * 64 + 1)) return NULL;
+     emitterInit(&emitter, &out);
+     for (size_t i = 0; i < list->count; ++i) emitToken(&emitter, &list->tokens[i]);
+     emitterFinish(&emitter);
+     return outBufRelease(&out);
+}
+
+/**
+ * Converts a document one token at a time into `out`. Only the current
+ * token's synthesized text is ever held, in `arena`, which is reset as it
+ * goes, so memory doesn't grow with the document.
+ *
+ * @return The number of tokens, or -1 if tokenizing or writing failed.
+ */
+long convertMarkdownStream(const char *markdown, size_t length, struct Arena *arena,
+                           struct OutBuf *out) {
+     Tokenizer tokenizer;
+     LatexEmitter emitter;
+     Token token;
+     long count = 0;
+
+     tokenizerInit(&tokenizer, markdown, length, arena);
+     emitterInit(&emitter, out);
+     while (nextToken(&tokenizer, &token)) {
+          emitToken(&emitter, &token);
+          arenaReset(arena);
+          count++;
+     }
+     emitterFinish(&emitter);
+     return tokenizer.failed || out->failed ? -1 : count;
+}
+
+/**
+ * Runs `work(arg)` on `count` threads and waits for them. Workers pull their
+ * share of the work from `arg` themselves; if no thread can be started, the
+ * work is done on the calling thread instead.
+ */
+static void runWorkers(size_t count, void *(*work)(void *), void *arg) {
+     pthread_t *workers = calloc(count ? count : 1, sizeof(pthread_t));
+     size_t started = 0;
+     while (workers && started < count &&
+            pthread_create(&workers[started], NULL, work, arg) == 0)
+          started++;
+     if (started == 0) work(arg);
+     for (size_t i = 0; i < started; ++i) pthread_join(workers[i], NULL);
+     free(workers);
+}
+
+/* Worker threads for a conversion: one per online core */
+static size_t coreCount(void) {
+     long cores = sysconf(_SC_NPROCESSORS_ONLN);
+     return cores > 0 ? (size_t)cores : 1;
+}
+
+/**
+ * A slice of a document that is tokenized and emitted on its own thread.
+ *
+ * Segments start after a blank line outside a code fence, where a fresh
+ * tokenizer is presumed to be in step with a serial one. That is checked
+ * afterwards against where the previous segment's tokenizer actually
+ * stopped: a bold or link spanning the blank line, or a fence the pre-scan
+ * misjudged, sends the segment back to be redone from there.
+ */
+typedef struct {
+     const char *start;
+     const char *end;
+     TokenList tokens;
+     /* Where tokenizing stopped, and whether inside a code fence */
+     const char *stop;
+     bool stopInsideCodeBlock;
+     /* Emitter state carried in from the segments before */
+     bool insideList;
+     bool written;
+     struct OutBuf out;
+     bool failed;
+} TexSegment;
+
+typedef struct {
+     const char *end;
+     TexSegment *segments;
+     size_t count;
+     atomic_size_t next;
+} TexDocument;
+
+/* Tokenizes a segment from `ptr`, in the given fence state, up to its end */
+static void tokenizeSegment(TexSegment *segment, const char *ptr, bool insideCodeBlock,
+                            const char *docEnd) {
+     Tokenizer tokenizer;
+     Token token;
+
+     tokenListFree(&segment->tokens);
+     tokenListInit(&segment->tokens);
+     tokenizerInit(&tokenizer, ptr, docEnd - ptr, &segment->tokens.arena);
+     tokenizer.limit = ptr > segment->end ? ptr : segment->end;
+     tokenizer.insideCodeBlock = insideCodeBlock;
+     while (nextToken(&tokenizer, &token)) {
+          if (!pushToken(&segment->tokens, &token)) {
+               tokenizer.failed = true;
+               break;
+          }
+     }
+     segment->stop = tokenizer.ptr;
+     segment->stopInsideCodeBlock = tokenizer.insideCodeBlock;
+     segment->failed = tokenizer.failed;
+}
+
+static void *tokenizeWorker(void *arg) {
+     TexDocument *doc = arg;
+     size_t i;
+     while ((i = atomic_fetch_add(&doc->next, 1)) < doc->count) {
+          TexSegment *segment = &doc->segments[i];
+          tokenizeSegment(segment, segment->start, false, doc->end);
+     }
+     return NULL;
+}
+
+static void *emitWorker(void *arg) {
+     TexDocument *doc = arg;
+     size_t i;
+     while ((i = atomic_fetch_add(&doc->next, 1)) < doc->count) {
+          TexSegment *segment = &doc->segments[i];
+          LatexEmitter emitter;
+
+          if (!outBufInit(&segment->out, -1, segment->tokens.count * 64 + 1)) {
+               segment->failed = true;
+               continue;
           }
+          emitterInit(&emitter, &segment->out);
+          emitter.insideList = segment->insideList;
+          emitter.written = segment->written;
+          for (size_t t = 0; t < segment->tokens.count; ++t) {
+               emitToken(&emitter, &segment->tokens.tokens[t]);
+          }
+          if (i == doc->count - 1) emitterFinish(&emitter);
+          if (segment->out.failed) segment->failed = true;
      }
+     return NULL;
+}
 
-     /* +1 for null terminator */
-     char *latex = malloc(totalLength + 1);
-     if (!latex) return NULL;
-     char *current = latex;
-     bool insideList = false;
+/**
+ * Cuts a document into about `count` segments at blank lines that a quick
+ * scan of "```" pairs puts outside code fences.
+ *
+ * @return The number of segments, at most `count`.
+ */
+static size_t splitSegments(const char *markdown, size_t length, TexSegment *segments,
+                            size_t count) {
+     const char *end = markdown + length;
+     const char *fence = memmem(markdown, length, "```", 3);
+     const char *start = markdown;
+     size_t target = length / count + 1, n = 0;
+     bool insideFence = false;
 
-     for (token = tokens; token; token = token->next) {
-          if (current != latex &&
-              (token->type == TOKEN_HEADER1 || token->type == TOKEN_HEADER2 ||
-               token->type == TOKEN_LIST_ITEM || token->type == TOKEN_CODE_BLOCK ||
-               token->type == TOKEN_LINK || token->type == TOKEN_NEWLINE)) {
-               current += sprintf(current, "\n");
+     while (n < count - 1) {
+          const char *want = start + target;
+          if (want >= end) break;
+
+          const char *blank = memmem(want, end - want, "\n\n", 2);
+          if (!blank) break;
+          while (fence && fence < blank) {
+               insideFence = !insideFence;
+               fence = memmem(fence + 3, end - fence - 3, "```", 3);
+          }
+          if (insideFence) {
+               /* Look again past the end of this fence */
+               if (!fence) break;
+               target = fence + 3 - start;
+               continue;
           }
 
-          switch (token->type) {
-               case TOKEN_HEADER1:
-               case TOKEN_HEADER2:
-                    if (insideList) {
-                         current += sprintf(current, "\\end{itemize}\n");
-                         insideList = false;
-                    }
-                    current += sprintf(current,
-                                       token->type == TOKEN_HEADER1 ? "\n\\section{%s}\n\n"
-                                                                    : "\n\\subsection{%s}\n\n",
-                                       token->content);
-                    break;
-               case TOKEN_BOLD:
-                    current += sprintf(current, "\\textbf{%s}", token->content);
-                    break;
-               case TOKEN_ITALIC:
-                    current += sprintf(current, "\\textbf{%s}", token->content);
-                    break;
-               case TOKEN_LINK:
-                    current += sprintf(current, "%s", token->content);
-                    break;
-               case TOKEN_LIST_ITEM:
-                    if (!insideList) {
-                         current += sprintf(current, "\\begin{itemize}\n");
-                         insideList = true;
-                    }
-                    current += sprintf(current, "     \\item %s", token->content);
-                    if (token->next && token->next->type != TOKEN_LIST_ITEM) {
-                         current += sprintf(current, "\n\\end{itemize}\n");
-                         insideList = false;
-                    }
-                    break;
-               case TOKEN_CODE_BLOCK:
-                    if (insideList) {
-                         current += sprintf(current, "\\end{itemize}\n");
-                         insideList = false;
-                    }
-                    current +=
-                        sprintf(current, "\\begin{verbatim}\n%s\\end{verbatim}", token->content);
-                    break;
-               case TOKEN_NEWLINE:
-                    current += sprintf(current, "\n");
-                    break;
-               case TOKEN_TEXT:
-                    current += sprintf(current, "%s", token->content);
-                    break;
+          segments[n].start = start;
+          segments[n].end = blank + 2;
+          start = segments[n++].end;
+          target = length / count + 1;
+     }
+     segments[n].start = start;
+     segments[n].end = end;
+     return n + 1;
+}
+
+/**
+ * Parallel counterpart of convertMarkdownStream() for big documents, with
+ * byte-identical output: segments are tokenized concurrently, checked and
+ * if need be redone in order, then emitted concurrently and written out in
+ * order. Unlike the stream, this holds the document's tokens and LaTeX in
+ * memory.
+ *
+ * @return The number of tokens, or -1 if tokenizing or writing failed.
+ */
+long convertMarkdownParallel(const char *markdown, size_t length, size_t jobs,
+                             struct OutBuf *out) {
+     size_t wanted = jobs * 4;
+     TexSegment *segments = calloc(wanted, sizeof(TexSegment));
+     if (!segments) return -1;
+
+     TexDocument doc = {.end = markdown + length, .segments = segments};
+     doc.count = splitSegments(markdown, length, segments, wanted);
+     runWorkers(jobs < doc.count ? jobs : doc.count, tokenizeWorker, &doc);
+
+     /* Replay the boundaries in order, as a serial tokenizer would meet them */
+     const char *ptr = markdown;
+     bool insideCodeBlock = false, insideList = false, written = false, failed = false;
+     long count = 0;
+     for (size_t i = 0; i < doc.count; ++i) {
+          TexSegment *segment = &segments[i];
+          if (segment->start != ptr || insideCodeBlock) {
+               tokenizeSegment(segment, ptr, insideCodeBlock, doc.end);
+          }
+          ptr = segment->stop;
+          insideCodeBlock = segment->stopInsideCodeBlock;
+          failed |= segment->failed;
+          count += segment->tokens.count;
+
+          segment->insideList = insideList;
+          segment->written = written;
+          for (size_t t = 0; t < segment->tokens.count; ++t) {
+               const Token *token = &segment->tokens.tokens[t];
+               insideList = token->type == TOKEN_LIST_ITEM;
+               written |= token->type != TOKEN_TEXT || token->length > 0;
+          }
+     }
+
+     if (!failed) {
+          atomic_store(&doc.next, 0);
+          runWorkers(jobs < doc.count ? jobs : doc.count, emitWorker, &doc);
+     }
+     for (size_t i = 0; i < doc.count; ++i) {
+          failed |= segments[i].failed;
+          if (!failed) outBufWrite(out, segments[i].out.data, segments[i].out.length);
+          outBufFree(&segments[i].out);
+          tokenListFree(&segments[i].tokens);
+     }
+     free(segments);
+     return failed || out->failed ? -1 : count;
+}
+
+/* Converter state at a block boundary, saved with each cached block */
+#define TEX_STATE_CODE_BLOCK 1
+#define TEX_STATE_LIST 2
+#define TEX_STATE_WRITTEN 4
+
+/* A block converted in this run, placed in the document's LaTeX */
+typedef struct {
+     struct TexCacheEntry entry;
+     size_t offset;
+} TexBlock;
+
+/**
+ * Start of the block after the one at `ptr`: the next line that opens with
+ * "# " or "## " outside a code fence, going by a scan of "```" pairs, or
+ * `end` if there is none. `fence` and `insideFence` carry the scan along.
+ */
+static const char *nextBlock(const char *ptr, const char *end, const char **fence,
+                             bool *insideFence) {
+     while (ptr < end) {
+          const char *newline = memmem(ptr, end - ptr, "\n#", 2);
+          if (!newline) break;
+          while (*fence && *fence < newline) {
+               *insideFence = !*insideFence;
+               *fence = memmem(*fence + 3, end - *fence - 3, "```", 3);
           }
+
+          const char *line = newline + 1;
+          if (!*insideFence &&
+              (startsWith(line, end, "# ", 2) || startsWith(line, end, "## ", 3)))
+               return line;
+          ptr = line;
+     }
+     return end;
+}
+
+static uint32_t emitterState(const LatexEmitter *emitter, bool insideCodeBlock) {
+     return (insideCodeBlock ? TEX_STATE_CODE_BLOCK : 0) |
+            (emitter->insideList ? TEX_STATE_LIST : 0) |
+            (emitter->written ? TEX_STATE_WRITTEN : 0);
+}
+
+static bool addBlock(TexBlock **blocks, size_t *count, size_t *capacity, TexBlock block) {
+     if (*count == *capacity) {
+          size_t grown = *capacity ? 2 * *capacity : 64;
+          TexBlock *resized = realloc(*blocks, grown * sizeof(TexBlock));
+          if (!resized) return false;
+          *blocks = resized;
+          *capacity = grown;
      }
+     (*blocks)[(*count)++] = block;
+     return true;
+}
 
-     if (insideList) {
-          current += sprintf(current, "\\end{itemize}\n");
+/**
+ * Converts a document block by block, a block being a header and whatever
+ * follows it up to the next one. Blocks are looked up in the cache at
+ * `cachePath` by a hash of their source and of the state they start in, so
+ * only blocks edited since the last run are tokenized and emitted again.
+ * The cache is then rewritten to hold exactly this document's blocks.
+ *
+ * A block whose last token runs on past its end (an unclosed fence or bold)
+ * depends on text outside it, so it is never cached, and the block after it
+ * is converted from wherever it left off.
+ *
+ * @return The number of tokens, or -1 if tokenizing or writing failed.
+ */
+long convertMarkdownIncremental(const char *markdown, size_t length, const char *cachePath,
+                                struct Arena *arena, struct OutBuf *out) {
+     const char *end = markdown + length, *ptr = markdown;
+     const char *fence = memmem(markdown, length, "```", 3);
+     bool insideFence = false, insideCodeBlock = false, failed = false;
+     TexBlock *blocks = NULL;
+     size_t count = 0, capacity = 0, rebuilt = 0;
+     struct TexCache cache;
+     /* The whole document's LaTeX, which the rewritten cache points into */
+     struct OutBuf latex;
+     LatexEmitter emitter;
+     long tokens = 0;
+
+     /* Sized for the LaTeX of last time, which is usually close */
+     texCacheOpen(&cache, cachePath);
+     if (!outBufInit(&latex, -1, (cache.file.length > length ? cache.file.length : length) + 1)) {
+          texCacheClose(&cache);
+          return -1;
      }
+     emitterInit(&emitter, &latex);
+
+     for (const char *start = markdown; start < end && !failed;) {
+          const char *stop = nextBlock(start, end, &fence, &insideFence);
+          TexBlock block = {.offset = latex.length};
+          bool cacheable = ptr == start;
+
+          if (cacheable) {
+               block.entry.state = emitterState(&emitter, insideCodeBlock);
+               block.entry.key = hash64(start, stop - start, block.entry.state);
+               const struct TexCacheEntry *hit = texCacheFind(&cache, block.entry.key);
+               if (hit) {
+                    outBufWrite(&latex, hit->latex, hit->length);
+                    insideCodeBlock = hit->state & TEX_STATE_CODE_BLOCK;
+                    emitter.insideList = hit->state & TEX_STATE_LIST;
+                    emitter.written = hit->state & TEX_STATE_WRITTEN;
+                    block.entry = *hit;
+                    tokens += hit->tokens;
+                    failed = !addBlock(&blocks, &count, &capacity, block);
+                    ptr = start = stop;
+                    continue;
+               }
+          }
+
+          Tokenizer tokenizer;
+          Token token;
+          tokenizerInit(&tokenizer, ptr, end - ptr, arena);
+          tokenizer.limit = ptr > stop ? ptr : stop;
+          tokenizer.insideCodeBlock = insideCodeBlock;
+          while (nextToken(&tokenizer, &token)) {
+               emitToken(&emitter, &token);
+               arenaReset(arena);
+               block.entry.tokens++;
+          }
+          failed = tokenizer.failed;
+          tokens += block.entry.tokens;
+          rebuilt++;
+          ptr = tokenizer.ptr;
+          insideCodeBlock = tokenizer.insideCodeBlock;
+
+          if (cacheable && ptr == stop) {
+               /* Saved with the state it leaves behind, for the next run to restore */
+               block.entry.length = latex.length - block.offset;
+               block.entry.state = emitterState(&emitter, insideCodeBlock);
+               failed |= !addBlock(&blocks, &count, &capacity, block);
+          }
+          start = stop;
+     }
+     emitterFinish(&emitter);
+
+     failed |= latex.failed;
+     if (!failed) outBufWrite(out, latex.data, latex.length);
+     /* Rewritten only when it no longer holds exactly this document's blocks */
+     if (!failed && (rebuilt > 0 || count != cache.count)) {
+          struct TexCacheEntry *entries = calloc(count ? count : 1, sizeof(*entries));
+          for (size_t i = 0; entries && i < count; ++i) {
+               entries[i] = blocks[i].entry;
+               entries[i].latex = latex.data + blocks[i].offset;
+          }
+          /* A cache that can't be saved only costs the next run a full conversion */
+          if (entries) texCacheSave(cachePath, entries, count);
+          free(entries);
+     }
+
+     texCacheClose(&cache);
+     outBufFree(&latex);
+     free(blocks);
+     return failed || out->failed ? -1 : tokens;
+}
+
+/* How convertFile() goes about a document */
+typedef struct {
+     /* Threads to split it over; 0 picks by size */
+     size_t jobs;
+     /* Reuse the LaTeX of unchanged blocks, cached beside the input as <input>.zobcache */
+     bool incremental;
+} TexOptions;
+
+/**
+ * Converts the markdown file at `inputPath` into `outputPath`, or stdout
+ * when that is NULL. The arena and the writer's buffer belong to the caller
+ * and are reused from one file to the next.
+ *
+ * `options->jobs` threads share the document when it is more than one; 0
+ * picks one per core for inputs of TEX_PARALLEL_MIN_SIZE and up, and streams
+ * the rest. Incremental conversion takes precedence, except on stdin, which
+ * has no file to keep a cache beside.
+ *
+ * @return 0 on success, -1 after reporting the failure on stderr.
+ */
+int convertFile(const char *inputPath, const char *outputPath, const TexOptions *options,
+                struct Arena *arena, struct OutBuf *out) {
+     struct InputFile input;
+     if (inputFileOpen(&input, inputPath) != 0) {
+          fprintf(stderr, "Failed to read file: %s: %s\n", inputPath, strerror(errno));
+          return -1;
+     }
+
+     int fd = STDOUT_FILENO;
+     if (outputPath) {
+          fd = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+          if (fd < 0) {
+               fprintf(stderr, "Failed to open output file: %s: %s\n", outputPath,
+                       strerror(errno));
+               inputFileClose(&input);
+               return -1;
+          }
+     }
+
+     size_t jobs = options->jobs;
+     if (jobs == 0) jobs = input.length >= TEX_PARALLEL_MIN_SIZE ? coreCount() : 1;
+
+     int rc = 0;
+     long count;
+     outBufAttach(out, fd);
+     if (options->incremental && strcmp(inputPath, "-") != 0) {
+          char cachePath[PATH_MAX];
+          snprintf(cachePath, sizeof(cachePath), "%s.zobcache", inputPath);
+          count = convertMarkdownIncremental(input.data, input.length, cachePath, arena, out);
+     } else if (jobs > 1) {
+          count = convertMarkdownParallel(input.data, input.length, jobs, out);
+     } else {
+          count = convertMarkdownStream(input.data, input.length, arena, out);
+     }
+     if (count == 0) {
+          fprintf(stderr, "Failed to tokenize markdown: %s\n", inputPath);
+          rc = -1;
+     } else {
+          outBufWrite(out, "\n", 1);
+          outBufFlush(out);
+          if (count < 0 || out->failed) {
+               fprintf(stderr, "Failed to convert tokens to LaTeX: %s\n", inputPath);
+               rc = -1;
+          }
+     }
+
+     if (outputPath) {
+          close(fd);
+          /* Leave no truncated output behind to be mistaken for a good one */
+          if (rc != 0) unlink(outputPath);
+     }
+     inputFileClose(&input);
+     return rc;
+}
+
+/* One file of a batch conversion */
+typedef struct {
+     char *input;
+     char *output;
+} TexJob;
+
+/**
+ * A batch conversion's work queue: workers claim jobs by bumping `next`, so
+ * a slow file only holds up the worker that drew it.
+ */
+typedef struct {
+     TexJob *jobs;
+     size_t count;
+     size_t capacity;
+     atomic_size_t next;
+     atomic_size_t converted;
+     /* Inputs that could not be queued, plus files whose conversion failed */
+     atomic_int failed;
+} TexBatch;
+
+static bool addJob(TexBatch *batch, const char *input, const char *output) {
+     if (batch->count == batch->capacity) {
+          size_t capacity = batch->capacity ? 2 * batch->capacity : 64;
+          TexJob *grown = realloc(batch->jobs, capacity * sizeof(TexJob));
+          if (!grown) return false;
+          batch->jobs = grown;
+          batch->capacity = capacity;
+     }
+
+     TexJob *job = &batch->jobs[batch->count];
+     job->input = strdup(input);
+     job->output = strdup(output);
+     if (!job->input || !job->output) {
+          free(job->input);
+          free(job->output);
+          return false;
+     }
+     batch->count++;
+     return true;
+}
+
+/* Queues `input`, to be written as `name` with .md swapped for .tex under `outDir` */
+static bool addMarkdown(TexBatch *batch, const char *input, const char *outDir, const char *name) {
+     char output[PATH_MAX];
+     size_t length = strlen(name);
+     if (length > 3 && strcmp(name + length - 3, ".md") == 0) length -= 3;
+     snprintf(output, sizeof(output), "%s/%.*s.tex", outDir, (int)length, name);
+     return addJob(batch, input, output);
+}
+
+/**
+ * Queues every .md file under `dir`, mirroring its subdirectories under
+ * `outDir` (which are created here, before any worker starts).
+ */
+static void addDirectory(TexBatch *batch, const char *dir, const char *outDir) {
+     DIR *handle = opendir(dir);
+     if (!handle) {
+          fprintf(stderr, "Failed to open directory: %s: %s\n", dir, strerror(errno));
+          batch->failed++;
+          return;
+     }
+
+     struct dirent *entry;
+     while ((entry = readdir(handle))) {
+          char path[PATH_MAX], outPath[PATH_MAX];
+          struct stat st;
+          const char *name = entry->d_name;
+          if (name[0] == '.') continue;
+
+          snprintf(path, sizeof(path), "%s/%s", dir, name);
+          if (stat(path, &st) != 0) continue;
+          if (S_ISDIR(st.st_mode)) {
+               snprintf(outPath, sizeof(outPath), "%s/%s", outDir, name);
+               if (mkdir(outPath, 0755) != 0 && errno != EEXIST) {
+                    fprintf(stderr, "Failed to create directory: %s: %s\n", outPath,
+                            strerror(errno));
+                    batch->failed++;
+                    continue;
+               }
+               addDirectory(batch, path, outPath);
+          } else if (S_ISREG(st.st_mode) && strlen(name) > 3 &&
+                     strcmp(name + strlen(name) - 3, ".md") == 0) {
+               if (!addMarkdown(batch, path, outDir, name)) batch->failed++;
+          }
+     }
+     closedir(handle);
+}
 
-     /* Null terminate the string */
-     *current = '\0';
-     return latex;
+/* Orders jobs by output path, and jobs with the same output by queue position */
+static int compareOutputs(const void *a, const void *b) {
+     const TexJob *left = *(const TexJob *const *)a, *right = *(const TexJob *const *)b;
+     int order = strcmp(left->output, right->output);
+     return order ? order : (left > right) - (left < right);
 }
 
+/**
+ * Fails every job whose output an earlier job already writes (x.md in two
+ * of the inputs both become out-dir/x.tex), so no two workers ever write
+ * the same file. A failed job keeps its place with its input freed.
+ *
+ * @return false if memory ran out before the check could be made.
+ */
+static bool failDuplicateOutputs(TexBatch *batch) {
+     if (batch->count < 2) return true;
+     TexJob **sorted = malloc(batch->count * sizeof(TexJob *));
+     if (!sorted) return false;
+     for (size_t i = 0; i < batch->count; ++i) sorted[i] = &batch->jobs[i];
+     qsort(sorted, batch->count, sizeof(TexJob *), compareOutputs);
+
+     for (size_t i = 1; i < batch->count; ++i) {
+          TexJob *job = sorted[i];
+          if (strcmp(job->output, sorted[i - 1]->output) != 0) continue;
+          fprintf(stderr, "Failed to convert %s: %s is already written from another input\n",
+                  job->input, job->output);
+          free(job->input);
+          job->input = NULL;
+          batch->failed++;
+     }
+     free(sorted);
+     return true;
+}
+
+/* Worker thread: its own arena and writer buffer serve every file it draws */
+static void *texWorker(void *arg) {
+     TexBatch *batch = arg;
+     struct Arena arena;
+     struct OutBuf out;
+     /* Files are already spread over the cores; each converts on one */
+     const TexOptions options = {.jobs = 1};
+
+     /* Without a buffer this worker takes nothing, leaving the queue to the others */
+     arenaInit(&arena);
+     if (!outBufInit(&out, -1, TEX_OUT_BUFFER_SIZE)) {
+          fprintf(stderr, "Memory allocation failed\n");
+          arenaFree(&arena);
+          return NULL;
+     }
+
+     size_t i;
+     while ((i = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+          /* Failed up front, and counted then */
+          if (!batch->jobs[i].input) continue;
+          if (convertFile(batch->jobs[i].input, batch->jobs[i].output, &options, &arena, &out) ==
+              0) {
+               atomic_fetch_add(&batch->converted, 1);
+          } else {
+               atomic_fetch_add(&batch->failed, 1);
+          }
+     }
+
+     outBufFree(&out);
+     arenaFree(&arena);
+     return NULL;
+}
+
+/**
+ * zob tex --batch <dir|files...> --out-dir <dir>
+ *
+ * Converts every input in this one process on a pool of one worker per
+ * core. A file that fails is reported and counted; the rest carry on.
+ */
+void runTexBatch(int argc, char **argv) {
+     const char *outDir = NULL;
+     TexBatch batch = {0};
+     struct stat st;
+
+     for (int i = 3; i < argc; ++i) {
+          if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) outDir = argv[++i];
+     }
+     if (!outDir) {
+          fprintf(stderr, "No output directory provided: use --out-dir <dir>.\n");
+          return;
+     }
+     if (mkdir(outDir, 0755) != 0 && errno != EEXIST) {
+          fprintf(stderr, "Failed to create directory: %s: %s\n", outDir, strerror(errno));
+          return;
+     }
+
+     for (int i = 3; i < argc; ++i) {
+          if (strcmp(argv[i], "--out-dir") == 0) {
+               i++;
+          } else if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+               addDirectory(&batch, argv[i], outDir);
+          } else {
+               const char *slash = strrchr(argv[i], '/');
+               if (!addMarkdown(&batch, argv[i], outDir, slash ? slash + 1 : argv[i]))
+                    batch.failed++;
+          }
+     }
+
+     /* Unchecked, two workers could end up writing one file: then nothing is converted */
+     if (failDuplicateOutputs(&batch)) {
+          size_t numWorkers = coreCount();
+          if (numWorkers > batch.count) numWorkers = batch.count;
+          runWorkers(numWorkers, texWorker, &batch);
+     } else {
+          fprintf(stderr, "Memory allocation failed\n");
+     }
+
+     /* Files left in the queue, when no worker could set itself up, failed too */
+     size_t taken = atomic_load(&batch.next);
+     if (taken < batch.count) batch.failed += batch.count - taken;
+
+     printf("Converted %zu of %zu files into %s", atomic_load(&batch.converted), batch.count,
+            outDir);
+     int failed = atomic_load(&batch.failed);
+     printf(failed ? "; %d failed\n" : "\n", failed);
+
+     for (size_t i = 0; i < batch.count; ++i) {
+          free(batch.jobs[i].input);
+          free(batch.jobs[i].output);
+     }
+     free(batch.jobs);
+}
+
+/**
+ * Converts `filePath` once, then again every time it is saved, until killed.
+ * The directory is watched rather than the file, as editors often save by
+ * renaming a new file over the old one.
+ */
+static void watchTex(const char *filePath, const char *outPath, const TexOptions *options,
+                     struct Arena *arena, struct OutBuf *out) {
+     char dir[PATH_MAX];
+     const char *slash = strrchr(filePath, '/');
+     const char *name = slash ? slash + 1 : filePath;
+     if (!slash) {
+          snprintf(dir, sizeof(dir), ".");
+     } else {
+          snprintf(dir, sizeof(dir), "%.*s", slash == filePath ? 1 : (int)(slash - filePath),
+                   filePath);
+     }
+
+     int fd = inotify_init1(IN_CLOEXEC);
+     if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+          fprintf(stderr, "Failed to watch file: %s: %s\n", filePath, strerror(errno));
+          if (fd >= 0) close(fd);
+          return;
+     }
+
+     char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+     bool changed = true;
+     while (1) {
+          if (changed) {
+               struct timespec start, done;
+               clock_gettime(CLOCK_MONOTONIC, &start);
+               if (convertFile(filePath, outPath, options, arena, out) == 0) {
+                    clock_gettime(CLOCK_MONOTONIC, &done);
+                    double ms = (done.tv_sec - start.tv_sec) * 1e3 +
+                                (done.tv_nsec - start.tv_nsec) / 1e6;
+                    printf("Updated %s in %.1f ms\n", outPath, ms);
+                    fflush(stdout);
+               }
+          }
+
+          ssize_t got = read(fd, events, sizeof(events));
+          if (got < 0 && errno == EINTR) continue;
+          if (got <= 0) break;
+
+          changed = false;
+          for (char *ptr = events; ptr < events + got;) {
+               struct inotify_event *event = (struct inotify_event *)ptr;
+               if (event->len > 0 && strcmp(event->name, name) == 0) changed = true;
+               ptr += sizeof(*event) + event->len;
+          }
+     }
+     close(fd);
+}
+
+/**
+ * zob tex [file.md | -] [-o out.tex] [-j threads] [--incremental]
+ * zob tex file.md -o out.tex --watch
+ * zob tex --batch <dir|files...> --out-dir <dir>
+ *
+ * The LaTeX goes to stdout, or to the -o file, through a TEX_OUT_BUFFER_SIZE
+ * buffer. "-" converts stdin, so `cat notes.md | zob tex -` works. -j sets
+ * how many threads split a single document; -j 1 always streams.
+ * --incremental only redoes the sections edited since the last run, and
+ * --watch does so each time the file is saved.
+ */
 void runTex(int argc, char **argv) {
      const char *filePath = NULL;
+     const char *outPath = NULL;
+     TexOptions options = {0};
+     bool watch = false;
+     char filename[256];
+
+     if (argc > 2 && strcmp(argv[2], "--batch") == 0) {
+          runTexBatch(argc, argv);
+          return;
+     }
 
      if (argc == 2 && strcmp(argv[1], "tex") == 0) {
-          char filename[256];
           printf("Enter the markdown filename: ");
           if (fgets(filename, sizeof(filename), stdin) != NULL) {
                filename[strcspn(filename, "\n")] = '\0';
@@ -282,37 +1358,47 @@ void runTex(int argc, char **argv) {
                fprintf(stderr, "Failed to read filename.\n");
                return;
           }
-     } else if (argc > 2) {
-          filePath = argv[2];
+     } else {
+          for (int i = 2; i < argc; ++i) {
+               if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                    outPath = argv[++i];
+               } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                    options.jobs = strtoul(argv[++i], NULL, 10);
+               } else if (strcmp(argv[i], "--incremental") == 0) {
+                    options.incremental = true;
+               } else if (strcmp(argv[i], "--watch") == 0) {
+                    options.incremental = watch = true;
+               } else {
+                    filePath = argv[i];
+               }
+          }
      }
 
      if (!filePath) {
           fprintf(stderr, "No filename provided.\n");
           return;
      }
-
-     char *markdownContent = readFileIntoString(filePath);
-     if (markdownContent == NULL) {
-          fprintf(stderr, "Failed to read file: %s\n", filePath);
+     if (watch && (!outPath || strcmp(filePath, "-") == 0)) {
+          fprintf(stderr, "--watch needs a file to watch and an output file: use -o <file>.\n");
           return;
      }
 
-     Token *tokens = tokenizeMarkdown(markdownContent);
-     if (!tokens) {
-          fprintf(stderr, "Failed to tokenize markdown.\n");
-          free(markdownContent);
+     struct Arena arena;
+     struct OutBuf out;
+     if (!outBufInit(&out, -1, TEX_OUT_BUFFER_SIZE)) {
+          fprintf(stderr, "Memory allocation failed\n");
           return;
      }
+     arenaInit(&arena);
 
-     char *latexContent = convertTokensToLatex(tokens);
-     freeTokens(tokens);
-     free(markdownContent);
-
-     if (latexContent) {
-          printf("%s\n", latexContent);
-          free(latexContent);
+     /* Whatever stdio already holds (the filename prompt) goes out first */
+     fflush(stdout);
+     if (watch) {
+          watchTex(filePath, outPath, &options, &arena, &out);
      } else {
-          fprintf(stderr, "Failed to convert tokens to LaTeX.\n");
+          convertFile(filePath, outPath, &options, &arena, &out);
      }
-}
 
+     arenaFree(&arena);
+     outBufFree(&out);
+}
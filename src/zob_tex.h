@@ -1,6 +1,56 @@
 #ifndef ZOB_TEX_H
 #define ZOB_TEX_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "utils/arena.h"
+#include "utils/outbuf.h"
+
+typedef enum {
+     TOKEN_TEXT,
+     TOKEN_HEADER1,
+     TOKEN_HEADER2,
+     TOKEN_BOLD,
+     TOKEN_ITALIC,
+     TOKEN_LINK,
+     TOKEN_LIST_ITEM,
+     TOKEN_CODE_BLOCK,
+     TOKEN_NEWLINE
+} TokenType;
+
+/**
+ * A token's text is a slice, not a copy: it points into the markdown source,
+ * or into the list's arena for text synthesized during tokenizing (links).
+ */
+typedef struct {
+     TokenType type;
+     const char *text;
+     size_t length;
+     /* Known to hold nothing LaTeX needs escaped, so it can be copied as is */
+     bool plain;
+} Token;
+
+/* Tokens in document order, in one contiguous array */
+typedef struct {
+     Token *tokens;
+     size_t count;
+     size_t capacity;
+     struct Arena arena;
+} TokenList;
+
+void tokenListInit(TokenList *list);
+void tokenListFree(TokenList *list);
+bool tokenizeMarkdown(const char *markdown, size_t length, TokenList *list);
+char *convertTokensToLatex(const TokenList *list);
+
+long convertMarkdownStream(const char *markdown, size_t length, struct Arena *arena,
+                           struct OutBuf *out);
+long convertMarkdownParallel(const char *markdown, size_t length, size_t jobs,
+                             struct OutBuf *out);
+long convertMarkdownIncremental(const char *markdown, size_t length, const char *cachePath,
+                                struct Arena *arena, struct OutBuf *out);
+
 void runTex(int argc, char **argv);
 
 #endif // ZOB_TEX_H
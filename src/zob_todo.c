@@ -22,7 +22,6 @@ typedef struct {
 } Todo;
 
 /* Initialization */
-void constructFullPath();
 void initializeGlobals();
 void setupSigintHandler();
 
@@ -43,36 +42,22 @@ void waitForEnterKey();
 /* Signal Handling */
 void handle_sigint(int sig);
 
-char ZOB_DB_PATH[PATH_MAX];
-
 /* main entrypoint */
-void runTodo() {
-     constructFullPath();
-     displayTodoMenu();
-}
-
-void constructFullPath() {
-     const char *homeDir = getenv("HOME");
-     if (!homeDir) {
-          fprintf(stderr, "「Z O B」— Cannot find the home directory.\n");
-          exit(EXIT_FAILURE);
-     }
-
-     snprintf(ZOB_DB_PATH, sizeof(ZOB_DB_PATH), "%s%s/%s", homeDir, ZOB_DIRECTORY, ZOB_DB_NAME);
-}
+void runTodo() { displayTodoMenu(); }
 
 /**
  * Interactive mode for managing TODO items.
- * Changes are persisted to the ZOB_DB SQLite
+ * Changes are persisted to the ZOB_DB SQLite, through the process's one
+ * connection to it, which already has the Todos table.
  */
 void displayTodoMenu() {
      int choice;
 
-     sqlite3 *db;
+     sqlite3 *db = db_zob();
 
-     if (db_open(ZOB_DB_PATH, &db) != SQLITE_OK) {
-          printf("*** Failed to open database at path: %s\n", ZOB_DB_PATH);
-          fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+     if (!db) {
+          const char *path = db_zob_path();
+          printf("*** Failed to open database at path: %s\n", path ? path : "(no HOME)");
           return;
      }
 
@@ -109,7 +94,6 @@ void displayTodoMenu() {
                     printf("Invalid option, please try again.\n");
           }
      }
-     sqlite3_close(db);
 }
 
 /* signal handler for sigint */
@@ -165,22 +149,6 @@ bool validateDate(const char *date) {
  * Adds a new TODO item to the `todos` table in ZOB_DB
  */
 void addTodo(sqlite3 *db) {
-     const char *sqlCreateTable =
-         "CREATE TABLE IF NOT EXISTS Todos ("
-         "todo_id INTEGER PRIMARY KEY, "
-         "due_date TEXT NOT NULL, "
-         "status TEXT NOT NULL, "
-         "title TEXT NOT NULL, "
-         "description TEXT);";
-
-     char *errMsg = NULL;
-     int rc = sqlite3_exec(db, sqlCreateTable, 0, 0, &errMsg);
-     if (rc != SQLITE_OK) {
-          fprintf(stderr, "Failed to create table: %s\n", errMsg);
-          sqlite3_free(errMsg);
-          return;
-     }
-
      Todo newTodo;
 
      printf("\n「Z O B」— Zen Org Binder\nReflect on the task's essence: ");
@@ -205,9 +173,8 @@ void addTodo(sqlite3 *db) {
          "INSERT INTO Todos (due_date, status, title, description) "
          "VALUES (?, ?, ?, ?);";
 
-     sqlite3_stmt *stmt;
-     rc = sqlite3_prepare_v2(db, sqlInsert, -1, &stmt, NULL);
-     if (rc != SQLITE_OK) {
+     sqlite3_stmt *stmt = db_statement(db, sqlInsert);
+     if (!stmt) {
           fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
           return;
      }
@@ -217,13 +184,13 @@ void addTodo(sqlite3 *db) {
      sqlite3_bind_text(stmt, 3, newTodo.title, -1, SQLITE_STATIC);
      sqlite3_bind_text(stmt, 4, newTodo.description, -1, SQLITE_STATIC);
 
-     rc = sqlite3_step(stmt);
+     int rc = sqlite3_step(stmt);
      if (rc != SQLITE_DONE) {
           fprintf(stderr, "Failed to insert todo item: %s\n", sqlite3_errmsg(db));
      } else {
           printf("「Z O B」— Your task joins the stream.\n");
      }
-     sqlite3_finalize(stmt);
+     sqlite3_reset(stmt);
 }
 
 /**
@@ -241,8 +208,8 @@ void removeTodo(sqlite3 *db) {
 
      /* Retrieve the task title before deletion */
      const char *sqlSelect = "SELECT title FROM Todos WHERE todo_id = ?;";
-     sqlite3_stmt *selectStmt;
-     if (sqlite3_prepare_v2(db, sqlSelect, -1, &selectStmt, NULL) != SQLITE_OK) {
+     sqlite3_stmt *selectStmt = db_statement(db, sqlSelect);
+     if (!selectStmt) {
           fprintf(stderr, "Failed to contemplate the task's existence: %s\n", sqlite3_errmsg(db));
           return;
      }
@@ -251,11 +218,11 @@ void removeTodo(sqlite3 *db) {
      int stepResult = sqlite3_step(selectStmt);
      if (stepResult != SQLITE_ROW) {
           printf("「Z O B」— No task with such ID was found.\n");
-          sqlite3_finalize(selectStmt);
+          sqlite3_reset(selectStmt);
           return;
      }
-     strncpy(title, (const char *)sqlite3_column_text(selectStmt, 0), sizeof(title));
-     sqlite3_finalize(selectStmt);
+     snprintf(title, sizeof(title), "%s", (const char *)sqlite3_column_text(selectStmt, 0));
+     sqlite3_reset(selectStmt);
 
      /* Confirm deletion */
      printf(
@@ -270,8 +237,8 @@ void removeTodo(sqlite3 *db) {
 
      /* Delete the task */
      const char *sqlDelete = "DELETE FROM Todos WHERE todo_id = ?;";
-     sqlite3_stmt *deleteStmt;
-     if (sqlite3_prepare_v2(db, sqlDelete, -1, &deleteStmt, NULL) != SQLITE_OK) {
+     sqlite3_stmt *deleteStmt = db_statement(db, sqlDelete);
+     if (!deleteStmt) {
           fprintf(stderr, "Failed to prepare for the task's release: %s\n", sqlite3_errmsg(db));
           return;
      }
@@ -281,39 +248,19 @@ void removeTodo(sqlite3 *db) {
      } else {
           printf("「Z O B」— \"%s\" has been released into the cosmos.\n", title);
      }
-     sqlite3_finalize(deleteStmt);
+     sqlite3_reset(deleteStmt);
 }
 
-/**
- * Callback function used by SQLite to process each row in the query result.
- * Formats and prints the todo item details in a table-like structure.
- */
-static int callback(void *NotUsed, int argc, char **argv, char **azColName) {
-     (void)NotUsed;
-
-     printf("| %-4s | %-10s | %-8s | %-20s | %-30s |\n",
-            argv[0] ? argv[0] : "NULL",   // ID
-            argv[1] ? argv[1] : "NULL",   // Due Date
-            argv[2] ? argv[2] : "NULL",   // Status
-            argv[3] ? argv[3] : "NULL",   // Title
-            argv[4] ? argv[4] : "NULL");  // Description
-
-     return 0;
+/* A possibly NULL text column, as the table shows it */
+static const char *columnText(sqlite3_stmt *stmt, int col) {
+     const unsigned char *text = sqlite3_column_text(stmt, col);
+     return text ? (const char *)text : "NULL";
 }
 
 /**
  * Displays all todo items sorted by their due date.
  */
 void viewTodosSortedByDate(sqlite3 *db) {
-     char *errMsg = NULL;
-     int rc;
-
-     rc = db_open(ZOB_DB_PATH, &db);
-     if (rc) {
-          fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
-          return;
-     }
-
      const char *sql =
          "SELECT todo_id, due_date, status, title, description FROM "
          "todos ORDER BY due_date ASC;";
@@ -329,11 +276,15 @@ void viewTodosSortedByDate(sqlite3 *db) {
          "---------------------------------------------------------------------"
          "-------------------\n");
 
-     rc = sqlite3_exec(db, sql, callback, 0, &errMsg);
-     if (rc != SQLITE_OK) {
-          fprintf(stderr, "Failed to select data: %s\n", errMsg);
-          sqlite3_free(errMsg);
-     }
+     sqlite3_stmt *stmt = db_statement(db, sql);
+     if (!stmt) return;
 
-     sqlite3_close(db);
+     int rc;
+     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+          printf("| %-4s | %-10s | %-8s | %-20s | %-30s |\n", columnText(stmt, 0),
+                 columnText(stmt, 1), columnText(stmt, 2), columnText(stmt, 3),
+                 columnText(stmt, 4));
+     }
+     if (rc != SQLITE_DONE) fprintf(stderr, "Failed to select data: %s\n", sqlite3_errmsg(db));
+     sqlite3_reset(stmt);
 }